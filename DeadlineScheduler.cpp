@@ -0,0 +1,76 @@
+//******************************************************************************************
+//  File: DeadlineScheduler.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "DeadlineScheduler.h"
+#include "ShadeLog.h"
+
+#include "Everything.h"
+
+namespace st
+{
+	DeadlineScheduler::Deadline DeadlineScheduler::s_Deadlines[DeadlineScheduler::MAX_DEADLINES];
+	byte DeadlineScheduler::s_nDeadlines = 0;
+	byte DeadlineScheduler::s_nArmed = 0;
+	byte DeadlineScheduler::s_nNext = DeadlineScheduler::NO_DEADLINE;
+
+//private
+//findNext - only runs when a deadline is armed or cancelled, never from the polling path
+	void DeadlineScheduler::findNext()
+	{
+		s_nNext = NO_DEADLINE;
+		for (byte id = 0; id < s_nDeadlines; id++) {
+			if (!s_Deadlines[id].armed) continue;
+			if ((s_nNext == NO_DEADLINE) || ((int32_t)(s_Deadlines[id].due - s_Deadlines[s_nNext].due) < 0)) s_nNext = id;
+		}
+	}
+
+//public
+//alloc
+	byte DeadlineScheduler::alloc()
+	{
+		if (s_nDeadlines >= MAX_DEADLINES) {
+			SHADE_LOG_ERROR("DeadlineScheduler::alloc - no free deadline, increase MAX_DEADLINES");
+			return NO_DEADLINE;
+		}
+		s_Deadlines[s_nDeadlines].armed = false;
+		return s_nDeadlines++;
+	}
+
+//arm
+	void DeadlineScheduler::arm(byte id, unsigned long delayMillis)
+	{
+		if (id >= s_nDeadlines) return;
+
+		s_Deadlines[id].due = millis() + delayMillis;
+		if (!s_Deadlines[id].armed) {
+			s_Deadlines[id].armed = true;
+			s_nArmed++;
+			st::Everything::bTimersPending++;
+		}
+		findNext();
+	}
+
+//cancel
+	void DeadlineScheduler::cancel(byte id)
+	{
+		if ((id >= s_nDeadlines) || !s_Deadlines[id].armed) return;
+
+		s_Deadlines[id].armed = false;
+		s_nArmed--;
+		if (st::Everything::bTimersPending > 0) st::Everything::bTimersPending--;
+		if (id == s_nNext) findNext();
+	}
+
+//millisUntilNext
+	unsigned long DeadlineScheduler::millisUntilNext()
+	{
+		if (s_nNext == NO_DEADLINE) return 0xFFFFFFFF;
+
+		int32_t left = (int32_t)(s_Deadlines[s_nNext].due - millis());
+		return (left > 0) ? (unsigned long)left : 0;
+	}
+}
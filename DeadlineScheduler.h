@@ -0,0 +1,67 @@
+//******************************************************************************************
+//  File: DeadlineScheduler.h
+//
+//  Summary:  DeadlineScheduler is one shared table of millisecond deadlines for every device on the board, replacing
+//			  each device's own "timer pending" flag and end time.
+//
+//			  All comparisons are done on the difference from millis(), so they keep working when millis() wraps after
+//			  about 49.7 days (deadlines must be less than 24 days out).  The earliest armed deadline is tracked as it
+//			  changes, so anyDue() and millisUntilNext() answer in O(1) for the main loop.
+//			  st::Everything::bTimersPending is kept in step here - it goes up once when a deadline is armed and down
+//			  once when it is cancelled, so devices no longer touch it directly.
+//
+//			  Each device calls alloc() once (in its constructor) and keeps the id.
+//
+//******************************************************************************************
+
+#ifndef ST_DEADLINESCHEDULER_H
+#define ST_DEADLINESCHEDULER_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	class DeadlineScheduler
+	{
+		public:
+			static const byte NO_DEADLINE = 0xFF;
+			static const byte MAX_DEADLINES = 8;        //one per shade - IS_DCMotor_ShadeControl checks MAX_SHADES fits
+
+			//new deadline id - NO_DEADLINE, and an error logged, if the table is full
+			static byte alloc();
+
+			//due delayMillis from now, replacing any earlier time for this id
+			static void arm(byte id, unsigned long delayMillis);
+
+			static void cancel(byte id);
+
+			static bool isArmed(byte id) { return (id < s_nDeadlines) && s_Deadlines[id].armed; }
+
+			//armed and its time has come
+			static bool isDue(byte id) { return isArmed(id) && ((int32_t)(millis() - s_Deadlines[id].due) >= 0); }
+
+			//any deadline due - O(1)
+			static bool anyDue() { return isDue(s_nNext); }
+
+			//time to the earliest deadline, 0 if one is due, 0xFFFFFFFF if none is armed - O(1)
+			static unsigned long millisUntilNext();
+
+			static byte armedCount() { return s_nArmed; }
+
+		private:
+			struct Deadline
+			{
+				unsigned long due;
+				bool armed;
+			};
+
+			static Deadline s_Deadlines[MAX_DEADLINES];
+			static byte s_nDeadlines;
+			static byte s_nArmed;
+			static byte s_nNext;                           //earliest armed deadline, or NO_DEADLINE
+
+			static void findNext();
+	};
+}
+
+#endif
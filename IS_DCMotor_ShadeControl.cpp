@@ -1,381 +1,1386 @@
-//******************************************************************************************
-//  File: IS_DCMotor_ShadeControl.cpp
-//  Authors: Tim O'Callaghan
-//
-//  See .h for details
-//
-//  Change History:
-//
-//    Date        Who            What
-//    ----        ---            ----
-//    2020-12-31  Tim OCallaghan
-//
-//
-//******************************************************************************************
-
-#include "IS_DCMotor_ShadeControl.h"
-
-#include "Constants.h"
-#include "Everything.h"
-#include <EEPROM.h>
-
-//open always means move shade to let light in
-//close always means move shade to block light
-
-
-namespace st
-
-{
-//private
-    //valid commands are Stop, Open and Close
-
-	void IS_DCMotor_ShadeControl::controlMotor(command c) 
-	{ 
-        const char* stateStr[] = {"dummy","open", "opening", "closed","closing","unknown"};
-
-        if (c == Open) {
-	         Serial.println("DEBUG-IS_DCMotor_ShadeControl::controlmotor open");
-		     digitalWrite(m_npinMotorOutputOpen, m_bInvertLogic ? LOW:HIGH); 
-			 digitalWrite(m_npinMotorOutputClose,m_bInvertLogic ? HIGH:LOW);
-             analogWrite(m_npinMotorOutputEnablePWM, m_lMotorPWMSpeed); 	
-
-     		 //Save time operation limit
-             m_lTimeOperationDone = millis() + (1000 * m_lOpenTimeLimit);		 
-
-     		 //Increment number of active timers if no timers active
-			 if (!m_bTimerPending) {
-     		    st::Everything::bTimersPending++;
-			     m_bTimerPending = true;
-			 }
-			 
-			 m_eCurrentState = opening;	
-			 
-    		//Queue the door status update the ST Cloud 
-	    	Everything::sendSmartStringNow(getName() + " " + stateStr[m_eCurrentState] );					
-
-
-	   } else if (c == Close) {
-   	         Serial.println("DEBUG-IS_DCMotor_ShadeControl::controlmotor closing");
-		     digitalWrite(m_npinMotorOutputOpen,  m_bInvertLogic ? HIGH : LOW);
-			 digitalWrite(m_npinMotorOutputClose,  m_bInvertLogic ? LOW : HIGH);
-             analogWrite(m_npinMotorOutputEnablePWM, m_lMotorPWMSpeed); 	
-
-			//Save time operation limit
-			m_lTimeOperationDone = millis() + 	(1000 * m_lCloseTimeLimit);	
-
-    		//Increment number of active timers
-     		st::Everything::bTimersPending++;
-			m_bTimerPending = true;		
-
-			m_eCurrentState = closing;	
-
-     		//Queue the door status update the ST Cloud 
-	    	Everything::sendSmartStringNow(getName() + " " +  stateStr[m_eCurrentState] );					
-			
-       } else if (c == Stop) {
-		   
-		     //DO NOT SET THE STATE HERE - should be done in update
-   	         Serial.println("DEBUG-IS_DCMotor_ShadeControl::controlmotor Stop");
-		     digitalWrite(m_npinMotorOutputOpen,  m_bInvertLogic  ? HIGH : LOW);
-			 digitalWrite(m_npinMotorOutputClose,  m_bInvertLogic ? HIGH : LOW);
-             analogWrite(m_npinMotorOutputEnablePWM,0); 	
-
-             CancelTimer();
-	      } else {
-			  
-		     Serial.print(F("DEBUG-IS_DCMotor_ShadeControl::controlmotor -unsupported command="));
-  		     Serial.println(c);
-	   }	   
-
-	}
-
-//public
-
-//constructor - called in your sketch's global variable declaration section
-	IS_DCMotor_ShadeControl::IS_DCMotor_ShadeControl(const __FlashStringHelper *name, byte pinSWOpen,unsigned long openTimeLimit,byte pinSWClosed,long closedTimeLimit,  bool interruptActiveState, bool internalPullup, byte pinOutputOpen,byte pinOutputClose, byte pinMotorEnablePWM, unsigned long PWMSpeedValue, state desiredStartingState, bool invertOutputLogic):Sensor(name),
-		m_nPinSWOpened(pinSWOpen),
-		m_lOpenTimeLimitUser(openTimeLimit),
-		m_nPinSWClosed(pinSWClosed),
-		m_lCloseTimeLimitUser(closedTimeLimit),
-		m_bInterruptActiveState(interruptActiveState),
-		m_bInternalPullup(internalPullup),
-		m_npinMotorOutputOpen(pinOutputOpen),
-		m_npinMotorOutputClose(pinOutputClose),
-        m_npinMotorOutputEnablePWM(pinMotorEnablePWM),
-		m_lMotorPWMSpeed(PWMSpeedValue),
-		m_eDesiredStartingState(desiredStartingState),    //note the desired starting state should have a switch on it- do not 
-		m_bInvertLogic(invertOutputLogic),
-		m_lTimeOperationDone(0),
-		m_bTimerPending(false),
-		m_eCurrentState(unknown)
-		{
-
-		//setup input pins if defined
-        if (m_nPinSWClosed!=0) {
-				pinMode(m_nPinSWClosed, (m_bInternalPullup)?INPUT_PULLUP:INPUT);
-		}
-
-        if (m_nPinSWOpened!=0) {
-				pinMode(m_nPinSWOpened, (m_bInternalPullup)?INPUT_PULLUP:INPUT);
-		}
-			
-		//define output pins
-		pinMode(m_npinMotorOutputOpen,OUTPUT);
-		pinMode(m_npinMotorOutputClose,OUTPUT);
-        pinMode(m_npinMotorOutputEnablePWM, OUTPUT);
-	}
-		
-//destructor
-	IS_DCMotor_ShadeControl::~IS_DCMotor_ShadeControl()
-	{
-	}
-	
-//init
-	void IS_DCMotor_ShadeControl::init()
-    {
-        const char* stateStr[] = {"dummy","open", "opening", "closed","closing","unknown"};
-	
-		//check starting state of switches
-		if (readPin(m_nPinSWClosed) == HIGH) {
-			m_eCurrentState = closed;
-		} else if (readPin(m_nPinSWOpened) == HIGH) {
-			m_eCurrentState = open;
-		} else {
-			m_eCurrentState = unknown;
-		}	
-		
-		//get values from eeprom
-		ReadTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);
-		
-		//if too high user the users input
-		if ((m_lOpenTimeLimit> 150) || (m_lCloseTimeLimit>150)) {
-			//use input values
-			m_lOpenTimeLimit = m_lOpenTimeLimitUser;
-			m_lCloseTimeLimit = m_lCloseTimeLimitUser;
-            WriteTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);		
-        }	
-				
-		Everything::sendSmartStringNow(getName() + " opentimeout:" + m_lOpenTimeLimit );
-		Everything::sendSmartStringNow(getName() + " closetimeout:" + m_lCloseTimeLimit );
-		
-		if ((m_eDesiredStartingState == open) && (m_eCurrentState != open)) {
-				controlMotor(Open);
-		} else if ((m_eDesiredStartingState == closed) && (m_eCurrentState != closed)) {
-		      	controlMotor(Close);
-		} else {	
-		    Everything::sendSmartStringNow(getName() + " " + stateStr[m_eCurrentState] );   
-        }
-		
-
-	}
-
-//update function 
-	void IS_DCMotor_ShadeControl::update() {
-        const char* stateStr[] = {"dummy","open", "opening", "closed","closing","unknown"};
-        bool stopmotor = false;
-
-		//open switch defined, opening and open switch hit
-		if ((m_nPinSWOpened != 0) && (m_eCurrentState == opening) && readPin(m_nPinSWOpened)) {
-			   Serial.println(F("DEBUG-IS_ShadeControl::update - hit opened switch"));
-			   m_eCurrentState = open;
-			   stopmotor=true;
-		//opening and hit timeout	   
-		} else if 	((m_bTimerPending) && (m_eCurrentState == opening) && (millis() > m_lTimeOperationDone)) {
-			   Serial.println(F("DEBUG-IS_ShadeControl::update - hit opened timeout"));
-			     //set to stopmotor and set state to open if no switch,otherwise the switch should have hit and it didnt so say unknown
-    			 stopmotor=true;
-				  m_eCurrentState = (m_nPinSWOpened ==0)?open:unknown;
-		//closed switch defined, closing and closed switch hit
-        } else if   ((m_nPinSWClosed != 0) &&  (m_eCurrentState == closing) && readPin(m_nPinSWClosed) )  {
-			   Serial.println(F("DEBUG-IS_ShadeControl::update - hit closed switch"));
-               //update state
-			   m_eCurrentState = closed;
-			   stopmotor=true;
-		//closing and hit timeout	   
-		} else if 	((m_bTimerPending) && (m_eCurrentState == closing) && (millis() > m_lTimeOperationDone)) {
-			   Serial.println(F("DEBUG-IS_ShadeControl::update - hit closing timeout"));
-			
-			     //set stopmotor and set state to closed if no switch,otherwise the switch should have hit and it didnt so say unknown
-     			  stopmotor=true;
-				  m_eCurrentState = (m_nPinSWClosed ==0)?closed:unknown;
-        }
-
-		if (stopmotor) {     
-
-			//stop motor
-			controlMotor(Stop);
-
-     		Everything::sendSmartStringNow(getName() + " " + stateStr[m_eCurrentState] );
-
-			Serial.print(F("DEBUG-IS_ShadeControl::update - sending state to hub: "));
-			Serial.println(stateStr[m_eCurrentState]);
-        }
- }
-
- 
-
-//beSmart function
-// windowShade open
-// windowShade close
-// windowShade setclosetimeout:nnnnn
-// windowShade setopentimeout:nnnnn
-	void IS_DCMotor_ShadeControl::beSmart(const String &str)
-	{
-		String s = str.substring(str.indexOf(' ') + 1);
-		int colonloc = str.indexOf(':');
-
-		String timeout = str.substring(str.indexOf(':') + 1);
-	
-		if (st::Sensor::debug) {
-			Serial.print(F("IS_DCMotor_ShadeControl::beSmart s = "));
-			Serial.println(s);
-		}
-
-		if (s == F("open")) {
-		{
-			Serial.println("DEBUG beSmart open path");
-			//if not in open state and no timer pending OR there is a valid open switch AND we are not at the open
-			 //if  ((m_eCurrentState != open) && (((!m_bTimerPending) || (m_nPinSWOpened>0)) && !readPin(m_nPinSWOpened))) {
-	
-            //if no timer and not already at open state and state is closed OR you have a valid open sw and open sw not active
-			//if ((!m_bTimerPending) && (m_eCurrentState != open) && ((m_eCurrentState == closed) || ((m_nPinSWOpened>0) && !readPin(m_nPinSWOpened)))) {
-
-            //if normal state of closed and no timer   OR  valid open switch and its not active
-			if (((m_eCurrentState == closed) && (!m_bTimerPending)) || ((m_nPinSWOpened>0) && !readPin(m_nPinSWOpened))) {
-	
-			 			controlMotor(Open);		
-			 } else {
-				 if (st::Sensor::debug) {
-	        	     Serial.println("conditions not met to call controlMotor with open ");
-				 }		 
-             }
-					  
-   			}
-			
-		}  else if (s == F("close")) {
-						Serial.println("DEBUG beSmart close path");
-						Serial.print("current state:");
-	                    Serial.println(m_eCurrentState);
-						Serial.print("timer pending:");
-						Serial.println(m_bTimerPending);
-
-            
-           //if normal state of open and no timer   OR  valid closed switch and its not active
-			if (((m_eCurrentState == open) && (!m_bTimerPending)) || ((m_nPinSWClosed>0) && !readPin(m_nPinSWClosed))) {
-			
-			//if no timer and not already at closed state and state is open OR you have a valid close sw and close sw not active
-            //if ((!m_bTimerPending) && (m_eCurrentState != closed) && ((m_eCurrentState == open) || ((m_nPinSWClosed>0) && !readPin(m_nPinSWClosed)))) {
-			  
-            //only close when no timers or have a close switch AND not at the close switch
-            //if (((!m_bTimerPending) || (m_nPinSWClosed>0)) && !readPin(m_nPinSWClosed)) {
-
-            // commented out ..but before only allowed close when opem 
-			//if ((m_eCurrentState == open) && (!m_bTimerPending)) {
-				
-     			controlMotor(Close);	
-
-			   //Queue the door status update the ST Cloud 
-			   Everything::sendSmartStringNow(getName() +  F(" closing") );				
-			}
-
-		} else if (s == F("stop")) {
-						Serial.print(F("DEBUG beSmart stop path"));
-						Serial.print("current state:");
-	                    Serial.println(m_eCurrentState);
-						Serial.print("timer pending:");
-						Serial.println(m_bTimerPending);
-             			controlMotor(Stop);	
-
-        //check for the set open and close timers
-		} else if (colonloc> -1) {
-			if (str.indexOf("setclosetimeout")>-1) {
-			     m_lCloseTimeLimit = timeout.toInt();
-                 Serial.print("Setting close timeout and sending info back to hub");
-        		 Everything::sendSmartStringNow(getName() + " closetimeout:" + timeout );
-
-			} else if (str.indexOf("setopentimeout")>-1) {	 
-				 m_lOpenTimeLimit = timeout.toInt();
-				 Serial.print("Setting open timeout and sending info back to hub");
-				 Everything::sendSmartStringNow(getName() + " opentimeout:" + timeout );
-            }
-
-            //write to EEPROM    
-	        WriteTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);		
-		}	
-		
-	}
-
-
-	//called periodically by Everything class to ensure ST Cloud is kept consistent with the state of the contact sensor
-//refresh function	
-	void IS_DCMotor_ShadeControl::refresh()
-	{
-        const char* stateStr[] = {"dummy","open", "opening", "closed","closing","unknown"};
-    	Serial.println(F("DEBUG-IS_ShadeControl::refresh - sending state,and timeouts to hub"));
-
-		Everything::sendSmartStringNow(getName() + " " + stateStr[m_eCurrentState] );   
-	    Everything::sendSmartStringNow(getName() + " opentimeout:" + m_lOpenTimeLimit );
-		Everything::sendSmartStringNow(getName() + " closetimeout:" + m_lCloseTimeLimit );
-		Serial.println(m_eCurrentState);
-	}
-
-    void IS_DCMotor_ShadeControl::CancelTimer()
-	{
-		if (st::Everything::bTimersPending > 0) st::Everything::bTimersPending--;
-		m_bTimerPending = false;
-	}
-
-//readPin function	
-	int IS_DCMotor_ShadeControl::readPin(byte pin)
-	{
-        if (pin == 0) {
-			return LOW;
-		} else {	
-			int value = digitalRead(pin);
-
-			if ((value == HIGH) && m_bInterruptActiveState) {
- 				return HIGH;
-			} else if ((value == LOW) && !m_bInterruptActiveState) {
-				return HIGH;
-			} else {
-				return LOW;
-			}	
-		}
-    }	
-
-//ReadTimerValues
-   void IS_DCMotor_ShadeControl::ReadTimerValues(unsigned int &open,unsigned int &close) {
-	   const int eepromAdress_start = 0;
-
-	    #if defined(ESP8266)|| defined(ESP32)
-           EEPROM.begin(512);  
-        #endif
-        EEPROM.get(eepromAdress_start, open); 
-        EEPROM.get(eepromAdress_start + sizeof(int), close); 
-        Serial.print("read eprom open:");
-        Serial.println(open);
-        Serial.print("read eprom close:");
-        Serial.println(close);
-
-   }
-
-//WriteTimerValues
-  void IS_DCMotor_ShadeControl::WriteTimerValues(unsigned int open,unsigned int close) {
-	  const int eepromAdress_start = 0;
-                 Serial.print("writing eeprom close:");
-                 Serial.println(close);
-
-	    #if defined(ESP8266)|| defined(ESP32)
-           EEPROM.begin(512);  
-        #endif
-		EEPROM.put(eepromAdress_start, open);
-        EEPROM.put(eepromAdress_start + sizeof(int), close); 
-    	#if defined(ESP8266)|| defined(ESP32)
-	    	EEPROM.commit();
-		#endif
-
-   }
-	
-}
-
-
+//******************************************************************************************
+//  File: IS_DCMotor_ShadeControl.cpp
+//  Authors: Tim O'Callaghan
+//
+//  See .h for details
+//
+//  Change History:
+//
+//    Date        Who            What
+//    ----        ---            ----
+//    2020-12-31  Tim OCallaghan
+//
+//
+//******************************************************************************************
+
+#include "IS_DCMotor_ShadeControl.h"
+
+#include "Constants.h"
+#include "Everything.h"
+#include "ShadeStore.h"
+#include "DeadlineScheduler.h"
+#include "ShadeLog.h"
+
+//open always means move shade to let light in
+//close always means move shade to block light
+
+//state and attribute names sent to the hub - kept in flash, indexed by enum state
+static const char STATE_DUMMY[] PROGMEM = "dummy";
+static const char STATE_OPEN[] PROGMEM = "open";
+static const char STATE_OPENING[] PROGMEM = "opening";
+static const char STATE_CLOSED[] PROGMEM = "closed";
+static const char STATE_CLOSING[] PROGMEM = "closing";
+static const char STATE_UNKNOWN[] PROGMEM = "unknown";
+static const char STATE_PARTIAL[] PROGMEM = "partially_open";  //the child driver turns this into "partially open"
+//windowShade has no obstructed value - an obstructed shade is partially open, the obstruction is its own attribute
+static const char* const STATE_STR[] PROGMEM = {STATE_DUMMY, STATE_OPEN, STATE_OPENING, STATE_CLOSED, STATE_CLOSING, STATE_UNKNOWN, STATE_PARTIAL, STATE_PARTIAL};
+
+static const char ATTR_OPENTIMEOUT[] PROGMEM = "opentimeout";
+static const char ATTR_CLOSETIMEOUT[] PROGMEM = "closetimeout";
+static const char ATTR_POSITION[] PROGMEM = "position";
+static const char ATTR_ACK[] PROGMEM = "ack";
+static const char ATTR_OBSTRUCTION[] PROGMEM = "obstruction";   //1 when the last move was stopped by an obstruction
+
+//verbs accepted from the hub by beSmart()
+static const char VERB_OPEN[] PROGMEM = "open";
+static const char VERB_CLOSE[] PROGMEM = "close";
+static const char VERB_STOP[] PROGMEM = "stop";
+static const char VERB_SETOPENTIMEOUT[] PROGMEM = "setopentimeout";
+static const char VERB_SETCLOSETIMEOUT[] PROGMEM = "setclosetimeout";
+static const char VERB_POSITION[] PROGMEM = "position";
+
+//metric names for printMetrics()
+static const char LABEL_SHADE[] PROGMEM = "shade";
+static const char METRIC_UPDATE_CYCLES[] PROGMEM = "shade_update_cycles";
+static const char METRIC_POLL_GAP_MAX[] PROGMEM = "shade_poll_gap_micros_max";
+static const char METRIC_STOP_LATENCY[] PROGMEM = "shade_stop_latency_micros";
+static const char METRIC_STOP_LATENCY_MAX[] PROGMEM = "shade_stop_latency_micros_max";
+static const char METRIC_SWITCH_STOPS[] PROGMEM = "shade_switch_stops";
+static const char METRIC_ISR_STOPS[] PROGMEM = "shade_isr_stops";
+static const char METRIC_ISR_GLITCHES[] PROGMEM = "shade_isr_glitches";
+static const char METRIC_OPEN_MOVES[] PROGMEM = "shade_open_moves";
+static const char METRIC_OPEN_MOVE_LAST[] PROGMEM = "shade_open_move_millis_last";
+static const char METRIC_OPEN_MOVE_MAX[] PROGMEM = "shade_open_move_millis_max";
+static const char METRIC_OPEN_MOVE_TOTAL[] PROGMEM = "shade_open_move_millis_total";
+static const char METRIC_CLOSE_MOVES[] PROGMEM = "shade_close_moves";
+static const char METRIC_CLOSE_MOVE_LAST[] PROGMEM = "shade_close_move_millis_last";
+static const char METRIC_CLOSE_MOVE_MAX[] PROGMEM = "shade_close_move_millis_max";
+static const char METRIC_CLOSE_MOVE_TOTAL[] PROGMEM = "shade_close_move_millis_total";
+static const char METRIC_MESSAGES_SENT[] PROGMEM = "shade_messages_sent";
+static const char METRIC_OBSTRUCTIONS[] PROGMEM = "shade_obstructions";
+static const char METRIC_VIRTUAL_LIMITS[] PROGMEM = "shade_virtual_limits";
+static const char METRIC_MESSAGES_SUPPRESSED[] PROGMEM = "shade_messages_suppressed";
+static const char METRIC_COMMANDS_ACCEPTED[] PROGMEM = "shade_commands_accepted";
+static const char METRIC_COMMANDS_COALESCED[] PROGMEM = "shade_commands_coalesced";
+static const char METRIC_COMMANDS_REJECTED[] PROGMEM = "shade_commands_rejected";
+static const char METRIC_COMMAND_PREEMPTIONS[] PROGMEM = "shade_command_preemptions";
+static const char METRIC_OPEN_TRAVEL[] PROGMEM = "shade_open_travel_millis";
+static const char METRIC_CLOSE_TRAVEL[] PROGMEM = "shade_close_travel_millis";
+
+//ramp profiles - fraction of full PWM (255 = 100%) at each of the RAMP_STEPS steps, indexed by rampProfile
+static const byte RAMP_LINEAR_TABLE[st::IS_DCMotor_ShadeControl::RAMP_STEPS] PROGMEM = {16,32,48,64,80,96,112,128,143,159,175,191,207,223,239,255};
+static const byte RAMP_SCURVE_TABLE[st::IS_DCMotor_ShadeControl::RAMP_STEPS] PROGMEM = {3,11,24,40,59,81,104,128,151,174,196,215,231,244,252,255};  //smoothstep 3x^2-2x^3
+static const byte* const RAMP_TABLE[] = {NULL, RAMP_LINEAR_TABLE, RAMP_SCURVE_TABLE};
+
+
+namespace st
+
+{
+	IS_DCMotor_ShadeControl* IS_DCMotor_ShadeControl::s_pIsrShades[IS_DCMotor_ShadeControl::MAX_ISR_SHADES];
+	byte IS_DCMotor_ShadeControl::s_nIsrShades = 0;
+	IS_DCMotor_ShadeControl* IS_DCMotor_ShadeControl::s_pShades[IS_DCMotor_ShadeControl::MAX_SHADES];
+	byte IS_DCMotor_ShadeControl::s_nShades = 0;
+
+//private
+    //valid commands are Stop, Open and Close
+
+	void IS_DCMotor_ShadeControl::controlMotor(command c) 
+	{ 
+
+        if (c == Open) {
+	         SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::controlMotor open");
+		     digitalWrite(m_npinMotorOutputOpen, m_bInvertLogic ? LOW:HIGH); 
+			 digitalWrite(m_npinMotorOutputClose,m_bInvertLogic ? HIGH:LOW);
+             startDuty();
+			 armSwitchInterrupt(m_nPinSWOpened);
+
+     		 //Save time operation limit - the scheduler keeps Everything::bTimersPending
+             DeadlineScheduler::arm(m_nTimer, moveTimeoutMillis(true));
+			 
+			 //position model - where the move started and when
+			 m_nMoveStartPosition = m_nPosition;    //only read while m_bPositionKnown
+			 m_nTargetPosition = NO_TARGET;
+			 m_eMoveCommand = Open;
+			 m_lMoveStartMillis = millis();
+			 m_nCurrentCount = 0;
+			 m_lCurrentSum = 0;
+
+			 //moving again clears an obstruction
+			 if (m_eCurrentState == obstructed) sendAttribute(ATTR_OBSTRUCTION, 0);
+			 m_eCurrentState = opening;	
+			 
+    		//Queue the door status update the ST Cloud 
+	    	sendState();
+
+
+	   } else if (c == Close) {
+   	         SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::controlMotor close");
+		     digitalWrite(m_npinMotorOutputOpen,  m_bInvertLogic ? HIGH : LOW);
+			 digitalWrite(m_npinMotorOutputClose,  m_bInvertLogic ? LOW : HIGH);
+             startDuty();
+			 armSwitchInterrupt(m_nPinSWClosed);
+
+			//Save time operation limit - the scheduler keeps Everything::bTimersPending
+			DeadlineScheduler::arm(m_nTimer, moveTimeoutMillis(false));
+
+			//position model - where the move started and when
+			m_nMoveStartPosition = m_nPosition;    //only read while m_bPositionKnown
+			m_nTargetPosition = NO_TARGET;
+			m_eMoveCommand = Close;
+			m_lMoveStartMillis = millis();
+			m_nCurrentCount = 0;
+			m_lCurrentSum = 0;
+
+			if (m_eCurrentState == obstructed) sendAttribute(ATTR_OBSTRUCTION, 0);
+			m_eCurrentState = closing;	
+
+     		//Queue the door status update the ST Cloud 
+	    	sendState();
+			
+       } else if (c == Stop) {
+		   
+		     //DO NOT SET THE STATE HERE - should be done in update
+   	         SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::controlMotor stop");
+		     m_nIsrArmedPin = 0;
+		     digitalWrite(m_npinMotorOutputOpen,  m_bInvertLogic  ? HIGH : LOW);
+			 digitalWrite(m_npinMotorOutputClose,  m_bInvertLogic ? HIGH : LOW);
+             setDuty(0);
+             m_lStopMillis = millis();
+             m_eRampPhase = RampNone;
+             m_bStopAtRampEnd = false;
+
+             CancelTimer();
+
+			 //how long the move ran
+			 if (m_eMoveCommand != Stop) {
+				 ShadeMoveStats &move = (m_eMoveCommand == Open) ? m_Stats.openMoves : m_Stats.closeMoves;
+				 move.millisLast = (uint32_t)(millis() - m_lMoveStartMillis);
+				 if (move.millisLast > move.millisMax) move.millisMax = move.millisLast;
+				 move.millisTotal += move.millisLast;
+				 move.moves++;
+				 m_eMoveCommand = Stop;
+			 }
+	      } else {
+			  
+		     SHADE_LOG_ERROR("IS_DCMotor_ShadeControl::controlMotor - unsupported command=%d", (int)c);
+	   }	   
+
+	}
+
+//public
+
+//constructor - called in your sketch's global variable declaration section
+	IS_DCMotor_ShadeControl::IS_DCMotor_ShadeControl(const __FlashStringHelper *name, byte pinSWOpen,unsigned long openTimeLimit,byte pinSWClosed,long closedTimeLimit,  bool interruptActiveState, bool internalPullup, byte pinOutputOpen,byte pinOutputClose, byte pinMotorEnablePWM, unsigned long PWMSpeedValue, state desiredStartingState, bool invertOutputLogic):Sensor(name),
+		m_nPinSWOpened(pinSWOpen),
+		m_nPinSWClosed(pinSWClosed),
+		m_lOpenTimeLimitUser(openTimeLimit),
+		m_lCloseTimeLimitUser(closedTimeLimit),
+		m_nTimer(DeadlineScheduler::alloc()),
+		m_bInternalPullup(internalPullup),
+		m_bInterruptActiveState(interruptActiveState),
+		m_npinMotorOutputOpen(pinOutputOpen),
+		m_npinMotorOutputClose(pinOutputClose),
+        m_npinMotorOutputEnablePWM(pinMotorEnablePWM),
+		m_lMotorPWMSpeed(PWMSpeedValue),
+		m_bInvertLogic(invertOutputLogic),
+		m_eCurrentState(unknown),
+		m_eDesiredStartingState(desiredStartingState),    //note the desired starting state should have a switch on it- do not 
+		m_bBatchFrames(false),
+		m_bBatching(false),
+		m_nFrameLen(0),
+		m_nQueuedVerb(NO_VERB),
+		m_nDeadMillis(DEFAULT_DEAD_MILLIS),
+		m_lStopMillis(0),
+		m_nPosition(0),
+		m_bPositionKnown(false),
+		m_nMoveStartPosition(0),
+		m_lTravelMillis(0),
+		m_lLastTravelMillis(0),
+		m_nTargetPosition(NO_TARGET),
+		m_nLastReportedPosition(NO_TARGET),
+		m_lLastPositionReportMillis(0),
+		m_lOpenTravelMillis(0),
+		m_lCloseTravelMillis(0),
+		m_lDuty(0),
+		m_eRampPhase(RampNone),
+		m_nRampStep(0),
+		m_lRampStepMillis(0),
+		m_lRampFromDuty(0),
+		m_lRampFloorDuty(0),
+		m_bStopAtRampEnd(false),
+		m_pRampUpTable(NULL),
+		m_pRampDownTable(NULL),
+		m_nRampUpMillis(0),
+		m_nRampDownMillis(0),
+		m_nCreepPercent(0),
+		m_bSwitchInterrupts(false),
+		m_lDebounceMicros(0),
+		m_nIsrArmedPin(0),
+		m_nIsrTrippedPin(0),
+		m_lIsrEdgeMicros(0),
+		m_lIsrCutMicros(0),
+		m_nPinCurrent(0),
+		m_nStallLevel(0),
+		m_nRiseLevel(0),
+		m_nBlankMillis(0),
+		m_nCurrentHead(0),
+		m_nCurrentCount(0),
+		m_lCurrentSum(0),
+		m_lLastSampleMillis(0),
+		m_lOpenTravelEstimate(0),
+		m_lCloseTravelEstimate(0),
+		m_lOpenTravelSaved(0),
+		m_lCloseTravelSaved(0),
+		m_nStoreSlot(ShadeStore::NO_SLOT),
+		m_lLastPollMicros(0),
+		m_eMoveCommand(Stop),
+		m_lMoveStartMillis(0)
+		{
+		resetStats();
+
+		if (s_nShades < MAX_SHADES) {
+			s_pShades[s_nShades++] = this;
+		} else {
+			SHADE_LOG_ERROR("IS_DCMotor_ShadeControl - too many shades for the shade list, increase MAX_SHADES");
+		}
+
+		//cache "<name> " once so every status message is a copy into a fixed buffer
+		m_nPrefixLen = getName().length();
+		if (m_nPrefixLen > sizeof(m_szPrefix) - 2) m_nPrefixLen = sizeof(m_szPrefix) - 2;
+		memcpy(m_szPrefix, getName().c_str(), m_nPrefixLen);
+		m_szPrefix[m_nPrefixLen++] = ' ';
+		m_szPrefix[m_nPrefixLen] = '\0';
+
+		//the outbound String is sized once here and reused, so copying a message into it never reallocates
+		m_sMsg.reserve(MSG_BUFFER_SIZE);
+		m_szQueuedArg[0] = '\0';
+
+
+		//setup input pins if defined
+        if (m_nPinSWClosed!=0) {
+				pinMode(m_nPinSWClosed, (m_bInternalPullup)?INPUT_PULLUP:INPUT);
+		}
+
+        if (m_nPinSWOpened!=0) {
+				pinMode(m_nPinSWOpened, (m_bInternalPullup)?INPUT_PULLUP:INPUT);
+		}
+			
+		//define output pins - the off level is latched first, the reset level of a pin may be "on" with inverted logic
+		digitalWrite(m_npinMotorOutputOpen, m_bInvertLogic ? HIGH : LOW);
+		digitalWrite(m_npinMotorOutputClose, m_bInvertLogic ? HIGH : LOW);
+		digitalWrite(m_npinMotorOutputEnablePWM, LOW);
+		pinMode(m_npinMotorOutputOpen,OUTPUT);
+		pinMode(m_npinMotorOutputClose,OUTPUT);
+        pinMode(m_npinMotorOutputEnablePWM, OUTPUT);
+	}
+		
+//destructor
+	IS_DCMotor_ShadeControl::~IS_DCMotor_ShadeControl()
+	{
+	}
+	
+//init
+	void IS_DCMotor_ShadeControl::init()
+    {
+		//get values from eeprom
+		ReadTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);
+	
+		//check starting state of switches, then the state saved before the restart
+		bool restored = false;
+		if (readPin(m_nPinSWClosed) == HIGH) {
+			m_eCurrentState = closed;
+			setPosition(0);
+		} else if (readPin(m_nPinSWOpened) == HIGH) {
+			m_eCurrentState = open;
+			setPosition(100);
+		} else {
+			m_eCurrentState = unknown;
+			restored = restoreState();
+		}	
+		
+		//if too high user the users input
+		if ((m_lOpenTimeLimit> 150) || (m_lCloseTimeLimit>150)) {
+			//use input values
+			m_lOpenTimeLimit = m_lOpenTimeLimitUser;
+			m_lCloseTimeLimit = m_lCloseTimeLimitUser;
+            WriteTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);		
+        }	
+		updateTravelTimes();
+				
+		beginBatch();
+		sendAttribute(ATTR_OPENTIMEOUT, m_lOpenTimeLimit);
+		sendAttribute(ATTR_CLOSETIMEOUT, m_lCloseTimeLimit);
+		if (m_bPositionKnown) sendPosition();
+		
+		//home only when there was nothing trustworthy to restore
+		if (!restored && (m_eDesiredStartingState == open) && (m_eCurrentState != open)) {
+				controlMotor(Open);
+		} else if (!restored && (m_eDesiredStartingState == closed) && (m_eCurrentState != closed)) {
+		      	controlMotor(Close);
+		} else {	
+		    sendState();
+        }
+		endBatch();
+		
+
+	}
+
+//safeStart - called from setup() before the network, init() runs later once the hub is up
+	void IS_DCMotor_ShadeControl::safeStart()
+	{
+		//the constructor already left the bridge off - say so again in case the sketch touched the pins since
+		controlMotor(Stop);
+
+		if (readPin(m_nPinSWClosed) == HIGH) {
+			m_eCurrentState = closed;
+			setPosition(0);
+		} else if (readPin(m_nPinSWOpened) == HIGH) {
+			m_eCurrentState = open;
+			setPosition(100);
+		}
+	}
+
+//update function 
+	void IS_DCMotor_ShadeControl::update() {
+        bool stopmotor = false;
+		bool hitswitch = false;
+
+		//nothing moving, no switch interrupt to confirm and no command waiting - skip the polling, only housekeeping
+		if ((m_eCurrentState != opening) && (m_eCurrentState != closing) && (m_nIsrTrippedPin == 0) && (m_nQueuedVerb == NO_VERB)) {
+			m_lLastPollMicros = 0;
+			ShadeStore::service();
+			return;
+		}
+
+		unsigned long startMicros = micros();
+		uint32_t startCycles = ShadeMetrics::cycles();
+		unsigned long prevPollMicros = m_lLastPollMicros;
+
+		//how long the switches went unwatched while the motor was running
+		if (((m_eCurrentState == opening) || (m_eCurrentState == closing)) && (prevPollMicros != 0)) {
+			unsigned long gap = (uint32_t)(startMicros - prevPollMicros);
+			if (gap > m_Stats.pollGapMicrosMax) m_Stats.pollGapMicrosMax = gap;
+		}
+		m_lLastPollMicros = startMicros;
+
+		//a limit switch interrupt has already cut the motor - check the switch once it has had time to settle
+		bool isrhold = false;
+		if (m_nIsrTrippedPin != 0) {
+			if ((uint32_t)(micros() - m_lIsrEdgeMicros) < m_lDebounceMicros) {
+				isrhold = true;
+			} else if (!readPin(m_nIsrTrippedPin)) {
+				//noise, not the switch - drive on in the same direction
+				SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - switch interrupt glitch, resuming");
+				m_Stats.isrGlitches++;
+				byte pin = m_nIsrTrippedPin;
+				m_nIsrTrippedPin = 0;
+				digitalWrite(m_npinMotorOutputOpen, ((m_eCurrentState == opening) != m_bInvertLogic) ? HIGH : LOW);
+				digitalWrite(m_npinMotorOutputClose, ((m_eCurrentState == closing) != m_bInvertLogic) ? HIGH : LOW);
+				armSwitchInterrupt(pin);
+			}
+			//still active - the switch branches below stop as usual
+		}
+
+		//motor already off, waiting for the switch to settle
+		if (isrhold) {
+		//open switch defined, opening and open switch hit
+		} else if ((m_nPinSWOpened != 0) && (m_eCurrentState == opening) && readPin(m_nPinSWOpened)) {
+			   SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - hit opened switch");
+			   m_eCurrentState = open;
+			   stopmotor=true;
+			   hitswitch=true;
+			   calibrate(true);
+			   setPosition(100);
+		//opening and hit timeout	   
+		} else if 	((m_eCurrentState == opening) && DeadlineScheduler::isDue(m_nTimer)) {
+			   SHADE_LOG_INFO("IS_DCMotor_ShadeControl::update - hit opened timeout");
+			     //set to stopmotor and set state to open if no switch,otherwise the switch should have hit and it didnt so say unknown
+    			 stopmotor=true;
+				  m_eCurrentState = (m_nPinSWOpened ==0)?open:unknown;
+				  if (m_eCurrentState == open) setPosition(100); else m_bPositionKnown = false;
+		//closed switch defined, closing and closed switch hit
+        } else if   ((m_nPinSWClosed != 0) &&  (m_eCurrentState == closing) && readPin(m_nPinSWClosed) )  {
+			   SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - hit closed switch");
+               //update state
+			   m_eCurrentState = closed;
+			   stopmotor=true;
+			   hitswitch=true;
+			   calibrate(false);
+			   setPosition(0);
+		//closing and hit timeout	   
+		} else if 	((m_eCurrentState == closing) && DeadlineScheduler::isDue(m_nTimer)) {
+			   SHADE_LOG_INFO("IS_DCMotor_ShadeControl::update - hit closing timeout");
+			
+			     //set stopmotor and set state to closed if no switch,otherwise the switch should have hit and it didnt so say unknown
+     			  stopmotor=true;
+				  m_eCurrentState = (m_nPinSWClosed ==0)?closed:unknown;
+				  if (m_eCurrentState == closed) setPosition(0); else m_bPositionKnown = false;
+		//motor current says stalled - the end of travel, or something in the way
+		} else if ((m_nPinCurrent != 0) && !isrhold && ((m_eCurrentState == opening) || (m_eCurrentState == closing)) && currentStalled()) {
+				stopmotor=true;
+				byte pos = estimatePosition();
+				bool atEnd = !m_bPositionKnown || ((m_eCurrentState == opening) ? (pos >= 100 - END_ZONE_PERCENT) : (pos <= END_ZONE_PERCENT));
+				if (atEnd) {
+					SHADE_LOG_INFO("IS_DCMotor_ShadeControl::update - stall at end of travel, average %lu", m_lCurrentSum / CURRENT_SAMPLES);
+					m_eCurrentState = (m_eCurrentState == opening) ? open : closed;
+					calibrate(m_eCurrentState == open);
+					setPosition((m_eCurrentState == open) ? 100 : 0);
+					m_Stats.virtualLimits++;
+				} else {
+					SHADE_LOG_ERROR("IS_DCMotor_ShadeControl::update - obstructed at %d, average %lu", pos, m_lCurrentSum / CURRENT_SAMPLES);
+					setPosition(pos);
+					m_eCurrentState = obstructed;
+					m_Stats.obstructions++;
+				}
+		//soft stop finished
+		} else if (m_bStopAtRampEnd && (m_eRampPhase == RampNone) && ((m_eCurrentState == opening) || (m_eCurrentState == closing))) {
+				SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - soft stop done");
+				stopmotor=true;
+				stopPartWay();
+		//partial move reached its target
+		} else if ((m_nTargetPosition != NO_TARGET) && ((m_eCurrentState == opening) || (m_eCurrentState == closing))) {
+			byte pos = estimatePosition();
+			if (((m_eCurrentState == opening) && (pos >= m_nTargetPosition)) || ((m_eCurrentState == closing) && (pos <= m_nTargetPosition))) {
+				SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - reached target position");
+				stopmotor=true;
+				setPosition(m_nTargetPosition);
+				m_eCurrentState = partial;
+			}
+        }
+
+		//step the PWM ramp, and start slowing down as the end of travel or the target comes up
+		if (!stopmotor && !isrhold && ((m_eCurrentState == opening) || (m_eCurrentState == closing))) {
+			if (m_eRampPhase != RampNone) runRamp();
+
+			if ((m_pRampDownTable != NULL) && (m_eRampPhase != RampDown) && !m_bStopAtRampEnd && m_bPositionKnown) {
+				//in full speed run time, not whole percent - one percent is a few hundred milliseconds of a slow shade
+				byte stopAt = (m_nTargetPosition != NO_TARGET) ? m_nTargetPosition : (m_eCurrentState == opening) ? 100 : 0;
+				unsigned long travel = (m_eCurrentState == opening) ? m_lOpenTravelMillis : m_lCloseTravelMillis;
+				unsigned long needed = ((unsigned long)((m_nMoveStartPosition > stopAt) ? m_nMoveStartPosition - stopAt : stopAt - m_nMoveStartPosition) * travel) / 100;
+				unsigned long done = m_lTravelMillis + travelSince(millis());
+				unsigned long remaining = (done >= needed) ? 0 : needed - done;
+
+				//to a stop for a target, to creep speed into the end of travel so the switch still trips
+				//both profiles cover half the distance between full speed and the floor, plus the floor speed all the way
+				unsigned long floorDuty = (m_nTargetPosition != NO_TARGET) ? 0 : (m_lMotorPWMSpeed * m_nCreepPercent) / 100;
+				if (remaining <= ((unsigned long)m_nRampDownMillis * (100 + ((m_nTargetPosition != NO_TARGET) ? 0 : m_nCreepPercent))) / 200) {
+					beginRampDown(floorDuty);
+					if (m_nTargetPosition != NO_TARGET) m_bStopAtRampEnd = true;
+				}
+			}
+		}
+
+		//live position while travelling, when there is one to estimate from - at most one report per POSITION_REPORT_MILLIS
+		if (!stopmotor && m_bPositionKnown && ((m_eCurrentState == opening) || (m_eCurrentState == closing)) && ((uint32_t)(millis() - m_lLastPositionReportMillis) >= POSITION_REPORT_MILLIS)) {
+			byte pos = estimatePosition();
+			if (pos != m_nLastReportedPosition) {
+				sendAttribute(ATTR_POSITION, pos);
+				m_nLastReportedPosition = pos;
+			}
+			m_lLastPositionReportMillis = millis();
+		}
+
+		if (stopmotor) {     
+
+			//stop motor
+			controlMotor(Stop);
+
+			//interrupt stops are timed edge to outputs cut in the ISR
+			//polled stops - the switch could have tripped any time since the previous poll, so measure from there
+			if (hitswitch && (m_nIsrTrippedPin != 0)) {
+				m_Stats.stopLatencyMicros = m_lIsrCutMicros;
+				m_Stats.isrStops++;
+			} else if (hitswitch && (prevPollMicros != 0)) {
+				m_Stats.stopLatencyMicros = (uint32_t)(micros() - prevPollMicros);
+			}
+			if (hitswitch) {
+				if (m_Stats.stopLatencyMicros > m_Stats.stopLatencyMicrosMax) m_Stats.stopLatencyMicrosMax = m_Stats.stopLatencyMicros;
+				m_Stats.switchStops++;
+			}
+			m_nIsrTrippedPin = 0;
+
+			beginBatch();
+     		sendState();
+			if (m_bPositionKnown) sendPosition();
+			if (m_eCurrentState == obstructed) sendAttribute(ATTR_OBSTRUCTION, 1);
+			endBatch();
+
+			SHADE_LOG_INFO("%s %s", getName().c_str(), stateName(m_eCurrentState));
+        }
+
+		//a waiting command - stops this move, or starts once the dead time is up
+		runQueue();
+
+		//deferred settings commit
+		ShadeStore::service();
+
+		unsigned long elapsed = (uint32_t)(micros() - startMicros);
+		m_Stats.updateCalls++;
+		m_Stats.updateMicrosTotal += elapsed;
+		if (elapsed > m_Stats.updateMicrosMax) m_Stats.updateMicrosMax = elapsed;
+		m_Stats.updateCycles.add(ShadeMetrics::cycles() - startCycles);
+ }
+
+ 
+
+//verb table used by beSmart() - to add a verb write a cmdXxx handler and add a line here
+	const IS_DCMotor_ShadeControl::ShadeVerb IS_DCMotor_ShadeControl::s_Verbs[] = {
+		{VERB_OPEN,            &IS_DCMotor_ShadeControl::cmdOpen,            false, VerbQueued},
+		{VERB_CLOSE,           &IS_DCMotor_ShadeControl::cmdClose,           false, VerbQueued},
+		{VERB_STOP,            &IS_DCMotor_ShadeControl::cmdStop,            false, VerbClearsQueue},
+		{VERB_SETOPENTIMEOUT,  &IS_DCMotor_ShadeControl::cmdSetOpenTimeout,  true,  VerbNow},
+		{VERB_SETCLOSETIMEOUT, &IS_DCMotor_ShadeControl::cmdSetCloseTimeout, true,  VerbNow},
+		{VERB_POSITION,        &IS_DCMotor_ShadeControl::cmdPosition,        true,  VerbQueued}
+	};
+
+//beSmart function
+// windowShade open
+// windowShade close
+// windowShade stop
+// windowShade setclosetimeout:nnnnn
+// windowShade setopentimeout:nnnnn
+// windowShade position:nn  (0 closed - 100 open)
+//parsed in place as "<name> <verb>[:<arg>]" - nothing is copied or allocated
+	void IS_DCMotor_ShadeControl::beSmart(const String &str)
+	{
+		const char *verb = str.c_str();
+		const char *space = strchr(verb, ' ');
+		if (space != NULL) verb = space + 1;
+
+		runCommand(verb);
+	}
+
+//runCommand function - "<verb>" or "<verb>:<value>" without the device name, from beSmart() or a ShadeGroup
+	void IS_DCMotor_ShadeControl::runCommand(const char *verb)
+	{
+		const char *arg;
+		byte i = findVerb(verb, arg);
+
+		if (st::Sensor::debug) {
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart s = %s", verb);
+		}
+
+		if (i == NO_VERB) {
+			SHADE_LOG_ERROR("IS_DCMotor_ShadeControl::beSmart - unknown command: %s", verb);
+			return;
+		}
+		PGM_P name = s_Verbs[i].name;
+		if (s_Verbs[i].needsArg && ((arg == NULL) || (*arg == '\0'))) {
+			SHADE_LOG_ERROR("IS_DCMotor_ShadeControl::beSmart - missing value for %s", name);
+			return;
+		}
+
+		//nothing to do - no ack, the hub gets the state instead, and the latest command wins over one waiting
+		if (!willRun(i, arg)) {
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart - %s leaves the shade as it is", name);
+			if (m_nQueuedVerb != NO_VERB) m_Stats.commandsCoalesced++;
+			m_nQueuedVerb = NO_VERB;
+			m_Stats.commandsRejected++;
+			sendRestingState();
+			return;
+		}
+
+		m_Stats.commandsAccepted++;
+		sendAck(name);
+
+		if (s_Verbs[i].queue == VerbNow) {
+			(this->*s_Verbs[i].handler)(arg);
+			return;
+		}
+
+		//the latest command wins - anything still waiting is dropped
+		if (m_nQueuedVerb != NO_VERB) {
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart - %s replaces a waiting %s", name, s_Verbs[m_nQueuedVerb].name);
+			m_Stats.commandsCoalesced++;
+			m_nQueuedVerb = NO_VERB;
+		}
+		if (s_Verbs[i].queue == VerbClearsQueue) {
+			(this->*s_Verbs[i].handler)(arg);
+			return;
+		}
+
+		m_nQueuedVerb = i;
+		if (arg != NULL) {
+			size_t argLen = strcspn(arg, " \r\n");
+			if (argLen > sizeof(m_szQueuedArg) - 1) argLen = sizeof(m_szQueuedArg) - 1;
+			memcpy(m_szQueuedArg, arg, argLen);
+			m_szQueuedArg[argLen] = '\0';
+		} else {
+			m_szQueuedArg[0] = '\0';
+		}
+
+		//idle and past the dead time - starts now, not on the next update()
+		runQueue();
+	}
+
+//wouldRun function - runCommand() would act on this rather than just report the state
+	bool IS_DCMotor_ShadeControl::wouldRun(const char *verb)
+	{
+		const char *arg;
+		byte i = findVerb(verb, arg);
+		if (i == NO_VERB) return false;
+		if (s_Verbs[i].needsArg && ((arg == NULL) || (*arg == '\0'))) return false;
+		return willRun(i, arg);
+	}
+
+//findVerb function - s_Verbs index of "<verb>[:<arg>]", or NO_VERB, and where the argument starts (NULL if none)
+	byte IS_DCMotor_ShadeControl::findVerb(const char *verb, const char *&arg)
+	{
+		size_t verbLen = strcspn(verb, ": \r\n");
+		arg = (verb[verbLen] == ':') ? verb + verbLen + 1 : NULL;
+
+		for (byte i = 0; i < sizeof(s_Verbs) / sizeof(s_Verbs[0]); i++) {
+			PGM_P name = s_Verbs[i].name;
+			if ((strncmp_P(verb, name, verbLen) == 0) && (pgm_read_byte(name + verbLen) == '\0')) return i;
+		}
+		return NO_VERB;
+	}
+
+//runQueue function - called from runCommand() and every update() while a command waits
+	void IS_DCMotor_ShadeControl::runQueue()
+	{
+		if (m_nQueuedVerb == NO_VERB) return;
+		const ShadeVerb &verb = s_Verbs[m_nQueuedVerb];
+
+		if ((m_eCurrentState == opening) || (m_eCurrentState == closing)) {
+			//already on a full move that way - nothing to change
+			if ((m_nTargetPosition == NO_TARGET) && !m_bStopAtRampEnd &&
+				(((verb.handler == &IS_DCMotor_ShadeControl::cmdOpen) && (m_eCurrentState == opening)) ||
+				 ((verb.handler == &IS_DCMotor_ShadeControl::cmdClose) && (m_eCurrentState == closing)))) {
+				m_nQueuedVerb = NO_VERB;
+				return;
+			}
+
+			//a switch interrupt or a soft stop is already ending this move - let update() finish it first
+			if ((m_nIsrTrippedPin != 0) || m_bStopAtRampEnd) return;
+
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::runQueue - stopping for %s", verb.name);
+			m_Stats.commandPreemptions++;
+			cmdStop(NULL);
+			return;
+		}
+
+		//the bridge stays off for the dead time before any start
+		if ((uint32_t)(millis() - m_lStopMillis) < m_nDeadMillis) return;
+
+		m_nQueuedVerb = NO_VERB;
+		(this->*verb.handler)((m_szQueuedArg[0] != '\0') ? m_szQueuedArg : NULL);
+	}
+
+//canOpen function - the guard for an open: not already open, or an open switch that isn't pressed
+	bool IS_DCMotor_ShadeControl::canOpen()
+	{
+		return (((m_eCurrentState == closed) || (m_eCurrentState == partial) || (m_eCurrentState == obstructed)) && !timerPending()) || ((m_nPinSWOpened>0) && !readPin(m_nPinSWOpened));
+	}
+
+//canClose function - the guard for a close: not already closed, or a closed switch that isn't pressed
+	bool IS_DCMotor_ShadeControl::canClose()
+	{
+		return (((m_eCurrentState == open) || (m_eCurrentState == partial) || (m_eCurrentState == obstructed)) && !timerPending()) || ((m_nPinSWClosed>0) && !readPin(m_nPinSWClosed));
+	}
+
+//cmdOpen function
+	void IS_DCMotor_ShadeControl::cmdOpen(const char *)
+	{
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart open path");
+
+            //if normal state of closed and no timer   OR  valid open switch and its not active
+			if (canOpen()) {
+	
+			 			controlMotor(Open);		
+			 } else {
+				 if (st::Sensor::debug) {
+	        	     SHADE_LOG_DEBUG("conditions not met to call controlMotor with open");
+				 }		 
+             }
+	}
+
+//cmdClose function
+	void IS_DCMotor_ShadeControl::cmdClose(const char *)
+	{
+						SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart close path, current state:%d timer pending:%d", m_eCurrentState, timerPending());
+
+            
+           //if normal state of open and no timer   OR  valid closed switch and its not active
+			if (canClose()) {
+     			controlMotor(Close);	//reports "closing" itself
+			}
+	}
+
+//cmdStop function
+	void IS_DCMotor_ShadeControl::cmdStop(const char *)
+	{
+						SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart stop path, current state:%d timer pending:%d", m_eCurrentState, timerPending());
+						bool moving = (m_eCurrentState == opening) || (m_eCurrentState == closing);
+
+			//soft stop - update() finishes the stop when the ramp reaches 0
+			if (moving && (m_pRampDownTable != NULL)) {
+				m_nTargetPosition = NO_TARGET;
+				beginRampDown(0);
+				m_bStopAtRampEnd = true;
+				return;
+			}
+             			controlMotor(Stop);	
+
+			if (moving) {
+				stopPartWay();
+				beginBatch();
+				sendState();
+				if (m_bPositionKnown) sendPosition();
+				endBatch();
+			}
+	}
+
+//stopPartWay function - a move stopped short of the end, keep the estimate so the next move starts from here
+//a move that started from an unknown position stays unknown, somewhere between the ends
+	void IS_DCMotor_ShadeControl::stopPartWay()
+	{
+		if (!m_bPositionKnown) {
+			m_eCurrentState = partial;
+			return;
+		}
+		setPosition(estimatePosition());
+		m_eCurrentState = (m_nPosition >= 100) ? open : (m_nPosition == 0) ? closed : partial;
+	}
+
+//cmdPosition function
+//0 and 100 are full moves that end on the switch or timeout, anything between stops on the travel time estimate
+	void IS_DCMotor_ShadeControl::cmdPosition(const char *arg)
+	{
+		unsigned long target = strtoul(arg, NULL, 10);
+		if (target > 100) target = 100;
+
+		if (st::Sensor::debug) {
+			SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::beSmart position path target:%lu", target);
+		}
+
+		//runQueue() only gets here once a move the other way has stopped and the dead time is up
+		//already there - report it, the motor is not touched
+		command move = positionMove(target);
+		if (move == Stop) {
+			if (m_bPositionKnown && (target == m_nPosition) && (target != 0) && (target != 100)) m_eCurrentState = partial;
+			sendRestingState();
+			return;
+		}
+
+		controlMotor(move);
+		if (m_bPositionKnown && (target != 0) && (target != 100)) m_nTargetPosition = (byte)target;
+	}
+
+//positionMove function - the move position:target needs from here, Stop when the shade is already there
+//without a known position a partial move can't be timed, so it runs to the end in that direction
+//an end move has the same guards as open and close - a shade already at that end stays put
+	command IS_DCMotor_ShadeControl::positionMove(unsigned long target)
+	{
+		if (m_bPositionKnown && (target == m_nPosition)) return Stop;
+
+		if (!m_bPositionKnown || (target == 0) || (target == 100)) {
+			bool opening = (target >= 50) && (!m_bPositionKnown || (target == 100));
+			if (opening) return canOpen() ? Open : Stop;
+			return canClose() ? Close : Stop;
+		}
+		return (target > m_nPosition) ? Open : Close;
+	}
+
+//willRun function - false for a command that would leave the shade as it is, so it isn't acknowledged
+	bool IS_DCMotor_ShadeControl::willRun(byte verb, const char *arg)
+	{
+		const ShadeVerb &v = s_Verbs[verb];
+		bool moving = (m_eCurrentState == opening) || (m_eCurrentState == closing);
+
+		//a stop with nothing to stop
+		if (v.queue == VerbClearsQueue) return moving || (m_nQueuedVerb != NO_VERB);
+		if (v.queue == VerbNow) return true;
+
+		//a move in progress is stopped first, then anything runs
+		if (moving) return true;
+		if (v.handler == &IS_DCMotor_ShadeControl::cmdOpen) return canOpen();
+		if (v.handler == &IS_DCMotor_ShadeControl::cmdClose) return canClose();
+		if (v.handler == &IS_DCMotor_ShadeControl::cmdPosition) {
+			unsigned long target = strtoul(arg, NULL, 10);
+			return positionMove((target > 100) ? 100 : target) != Stop;
+		}
+		return true;
+	}
+
+//sendRestingState function - state, and the position when it is known, as one frame
+	void IS_DCMotor_ShadeControl::sendRestingState()
+	{
+		beginBatch();
+		sendState();
+		if (m_bPositionKnown) sendPosition();
+		endBatch();
+	}
+
+//cmdSetOpenTimeout function
+	void IS_DCMotor_ShadeControl::cmdSetOpenTimeout(const char *arg)
+	{
+		 m_lOpenTimeLimit = strtoul(arg, NULL, 10);
+		 SHADE_LOG_INFO("%s open timeout %u", getName().c_str(), m_lOpenTimeLimit);
+		 sendAttribute(ATTR_OPENTIMEOUT, m_lOpenTimeLimit);
+		 updateTravelTimes();
+
+         //write to EEPROM    
+	     WriteTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);		
+	}
+
+//cmdSetCloseTimeout function
+	void IS_DCMotor_ShadeControl::cmdSetCloseTimeout(const char *arg)
+	{
+	     m_lCloseTimeLimit = strtoul(arg, NULL, 10);
+         SHADE_LOG_INFO("%s close timeout %u", getName().c_str(), m_lCloseTimeLimit);
+         sendAttribute(ATTR_CLOSETIMEOUT, m_lCloseTimeLimit);
+		 updateTravelTimes();
+
+         //write to EEPROM    
+	     WriteTimerValues(m_lOpenTimeLimit,m_lCloseTimeLimit);		
+	}
+
+
+	//called periodically by Everything class to ensure ST Cloud is kept consistent with the state of the contact sensor
+//refresh function	
+	void IS_DCMotor_ShadeControl::refresh()
+	{
+    	SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::refresh - sending state %d and timeouts to hub", m_eCurrentState);
+
+		beginBatch();
+		sendState();
+	    sendAttribute(ATTR_OPENTIMEOUT, m_lOpenTimeLimit);
+		sendAttribute(ATTR_CLOSETIMEOUT, m_lCloseTimeLimit);
+		if (m_bPositionKnown) sendAttribute(ATTR_POSITION, estimatePosition());
+		sendAttribute(ATTR_OBSTRUCTION, (m_eCurrentState == obstructed) ? 1 : 0);
+		endBatch();
+	}
+
+//resetStats function
+	void IS_DCMotor_ShadeControl::resetStats()
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+	}
+
+//printMetrics function
+	void IS_DCMotor_ShadeControl::printMetrics(Print &out) const
+	{
+		//the cached prefix less its trailing space is the label value
+		char name[sizeof(m_szPrefix)];
+		memcpy(name, m_szPrefix, m_nPrefixLen - 1);
+		name[m_nPrefixLen - 1] = '\0';
+
+		ShadeMetrics::printHistogram(out, METRIC_UPDATE_CYCLES, LABEL_SHADE, name, m_Stats.updateCycles);
+		ShadeMetrics::printValue(out, METRIC_POLL_GAP_MAX, LABEL_SHADE, name, m_Stats.pollGapMicrosMax);
+		ShadeMetrics::printValue(out, METRIC_STOP_LATENCY, LABEL_SHADE, name, m_Stats.stopLatencyMicros);
+		ShadeMetrics::printValue(out, METRIC_STOP_LATENCY_MAX, LABEL_SHADE, name, m_Stats.stopLatencyMicrosMax);
+		ShadeMetrics::printValue(out, METRIC_SWITCH_STOPS, LABEL_SHADE, name, m_Stats.switchStops);
+		ShadeMetrics::printValue(out, METRIC_ISR_STOPS, LABEL_SHADE, name, m_Stats.isrStops);
+		ShadeMetrics::printValue(out, METRIC_ISR_GLITCHES, LABEL_SHADE, name, m_Stats.isrGlitches);
+		ShadeMetrics::printValue(out, METRIC_OPEN_MOVES, LABEL_SHADE, name, m_Stats.openMoves.moves);
+		ShadeMetrics::printValue(out, METRIC_OPEN_MOVE_LAST, LABEL_SHADE, name, m_Stats.openMoves.millisLast);
+		ShadeMetrics::printValue(out, METRIC_OPEN_MOVE_MAX, LABEL_SHADE, name, m_Stats.openMoves.millisMax);
+		ShadeMetrics::printValue(out, METRIC_OPEN_MOVE_TOTAL, LABEL_SHADE, name, m_Stats.openMoves.millisTotal);
+		ShadeMetrics::printValue(out, METRIC_CLOSE_MOVES, LABEL_SHADE, name, m_Stats.closeMoves.moves);
+		ShadeMetrics::printValue(out, METRIC_CLOSE_MOVE_LAST, LABEL_SHADE, name, m_Stats.closeMoves.millisLast);
+		ShadeMetrics::printValue(out, METRIC_CLOSE_MOVE_MAX, LABEL_SHADE, name, m_Stats.closeMoves.millisMax);
+		ShadeMetrics::printValue(out, METRIC_CLOSE_MOVE_TOTAL, LABEL_SHADE, name, m_Stats.closeMoves.millisTotal);
+		ShadeMetrics::printValue(out, METRIC_MESSAGES_SENT, LABEL_SHADE, name, m_Stats.messagesSent);
+		ShadeMetrics::printValue(out, METRIC_OBSTRUCTIONS, LABEL_SHADE, name, m_Stats.obstructions);
+		ShadeMetrics::printValue(out, METRIC_VIRTUAL_LIMITS, LABEL_SHADE, name, m_Stats.virtualLimits);
+		ShadeMetrics::printValue(out, METRIC_MESSAGES_SUPPRESSED, LABEL_SHADE, name, m_Stats.messagesSuppressed);
+		ShadeMetrics::printValue(out, METRIC_COMMANDS_ACCEPTED, LABEL_SHADE, name, m_Stats.commandsAccepted);
+		ShadeMetrics::printValue(out, METRIC_COMMANDS_COALESCED, LABEL_SHADE, name, m_Stats.commandsCoalesced);
+		ShadeMetrics::printValue(out, METRIC_COMMANDS_REJECTED, LABEL_SHADE, name, m_Stats.commandsRejected);
+		ShadeMetrics::printValue(out, METRIC_COMMAND_PREEMPTIONS, LABEL_SHADE, name, m_Stats.commandPreemptions);
+		ShadeMetrics::printValue(out, METRIC_OPEN_TRAVEL, LABEL_SHADE, name, m_lOpenTravelMillis);
+		ShadeMetrics::printValue(out, METRIC_CLOSE_TRAVEL, LABEL_SHADE, name, m_lCloseTravelMillis);
+	}
+
+//setPosition function - position is known from here on
+	void IS_DCMotor_ShadeControl::setPosition(byte pos)
+	{
+		m_nPosition = pos;
+		m_bPositionKnown = true;
+	}
+
+//estimatePosition function
+//dead reckoning - fraction of the full speed travel time run since the move started, 0 closed to 100 open
+	byte IS_DCMotor_ShadeControl::estimatePosition() const
+	{
+		if ((m_eCurrentState != opening) && (m_eCurrentState != closing)) return m_nPosition;
+
+		unsigned long travel = (m_eCurrentState == opening) ? m_lOpenTravelMillis : m_lCloseTravelMillis;
+		unsigned long moved = (travel == 0) ? 100 : ((m_lTravelMillis + travelSince(millis())) * 100UL) / travel;
+
+		if (m_eCurrentState == opening) {
+			return (m_nMoveStartPosition + moved >= 100) ? 100 : m_nMoveStartPosition + moved;
+		} else {
+			return (moved >= m_nMoveStartPosition) ? 0 : m_nMoveStartPosition - moved;
+		}
+	}
+
+//travelSince function - full speed equivalent milliseconds run at the current duty since the last duty change
+	unsigned long IS_DCMotor_ShadeControl::travelSince(unsigned long now) const
+	{
+		if (m_lMotorPWMSpeed == 0) return 0;
+		return ((uint32_t)(now - m_lLastTravelMillis) * m_lDuty) / m_lMotorPWMSpeed;
+	}
+
+//setDuty function - all PWM changes go through here so the position model sees slow ramps as slow travel
+	void IS_DCMotor_ShadeControl::setDuty(unsigned long duty)
+	{
+		unsigned long now = millis();
+		m_lTravelMillis += travelSince(now);
+		m_lLastTravelMillis = now;
+		m_lDuty = duty;
+		analogWrite(m_npinMotorOutputEnablePWM, duty);
+	}
+
+//startDuty function - first PWM output of a move, full speed or the first ramp step
+	void IS_DCMotor_ShadeControl::startDuty()
+	{
+		m_lTravelMillis = 0;
+		m_lLastTravelMillis = millis();
+		m_lDuty = 0;
+		m_bStopAtRampEnd = false;
+
+		if (m_pRampUpTable != NULL) {
+			m_eRampPhase = RampUp;
+			m_nRampStep = 0;
+			m_lRampStepMillis = millis();
+			setDuty((m_lMotorPWMSpeed * pgm_read_byte(m_pRampUpTable)) / 255);
+		} else {
+			m_eRampPhase = RampNone;
+			setDuty(m_lMotorPWMSpeed);
+		}
+	}
+
+//beginRampDown function - slow from the current duty to floorDuty over the deceleration time
+	void IS_DCMotor_ShadeControl::beginRampDown(unsigned long floorDuty)
+	{
+		if (floorDuty >= m_lDuty) return;
+		m_eRampPhase = RampDown;
+		m_nRampStep = 0;
+		m_lRampStepMillis = millis();
+		m_lRampFromDuty = m_lDuty;
+		m_lRampFloorDuty = floorDuty;
+	}
+
+//runRamp function - one step per (ramp time / RAMP_STEPS), never blocks
+	void IS_DCMotor_ShadeControl::runRamp()
+	{
+		unsigned int stepMillis = ((m_eRampPhase == RampUp) ? m_nRampUpMillis : m_nRampDownMillis) / RAMP_STEPS;
+		if ((uint32_t)(millis() - m_lRampStepMillis) < stepMillis) return;
+		m_lRampStepMillis = millis();
+
+		if (++m_nRampStep >= RAMP_STEPS) m_nRampStep = RAMP_STEPS - 1;
+		if (m_eRampPhase == RampUp) {
+			setDuty((m_lMotorPWMSpeed * pgm_read_byte(m_pRampUpTable + m_nRampStep)) / 255);
+		} else {
+			//walk the table backwards from full to 0 of the span above the floor
+			unsigned long span = m_lRampFromDuty - m_lRampFloorDuty;
+			setDuty(m_lRampFloorDuty + (span * pgm_read_byte(m_pRampDownTable + (RAMP_STEPS - 1 - m_nRampStep))) / 255);
+			if (m_nRampStep == RAMP_STEPS - 1) setDuty(m_lRampFloorDuty);
+		}
+		if (m_nRampStep == RAMP_STEPS - 1) m_eRampPhase = RampNone;
+	}
+
+//enableSwitchInterrupts function
+	void IS_DCMotor_ShadeControl::enableSwitchInterrupts(unsigned long debounceMicros)
+	{
+		if (m_bSwitchInterrupts) return;
+		if (s_nIsrShades >= MAX_ISR_SHADES) {
+			SHADE_LOG_ERROR("IS_DCMotor_ShadeControl::enableSwitchInterrupts - too many shades, polling only");
+			return;
+		}
+
+		m_lDebounceMicros = debounceMicros;
+		s_pIsrShades[s_nIsrShades++] = this;
+		m_bSwitchInterrupts = true;
+
+		//pins without interrupt support are still polled by update()
+		if (m_nPinSWOpened != 0) attachInterrupt(digitalPinToInterrupt(m_nPinSWOpened), switchISR, CHANGE);
+		if (m_nPinSWClosed != 0) attachInterrupt(digitalPinToInterrupt(m_nPinSWClosed), switchISR, CHANGE);
+	}
+
+//armSwitchInterrupt function - the ISR only acts on the switch at the end we are driving towards
+	void IS_DCMotor_ShadeControl::armSwitchInterrupt(byte pin)
+	{
+		m_nIsrTrippedPin = 0;
+		m_nIsrArmedPin = m_bSwitchInterrupts ? pin : 0;
+	}
+
+//switchISR function - shared by every switch pin, each shade checks its own armed pin
+	void IRAM_ATTR IS_DCMotor_ShadeControl::switchISR()
+	{
+		for (byte i = 0; i < s_nIsrShades; i++) {
+			s_pIsrShades[i]->switchEdge();
+		}
+	}
+
+//switchEdge function - runs in interrupt context, cut the bridge and leave the bookkeeping to update()
+	void IRAM_ATTR IS_DCMotor_ShadeControl::switchEdge()
+	{
+		byte pin = m_nIsrArmedPin;
+		if (pin == 0) return;
+
+		unsigned long edge = micros();
+		if ((digitalRead(pin) == HIGH) != m_bInterruptActiveState) return;   //edge back to inactive
+
+		digitalWrite(m_npinMotorOutputOpen, m_bInvertLogic ? HIGH : LOW);
+		digitalWrite(m_npinMotorOutputClose, m_bInvertLogic ? HIGH : LOW);
+
+		//disarm so bounces are ignored until update() has looked at it
+		m_nIsrArmedPin = 0;
+		m_lIsrEdgeMicros = edge;
+		m_lIsrCutMicros = (uint32_t)(micros() - edge);
+		m_nIsrTrippedPin = pin;
+	}
+
+//setRamp function
+	void IS_DCMotor_ShadeControl::setRamp(rampProfile accelProfile, unsigned int accelMillis, rampProfile decelProfile, unsigned int decelMillis, byte creepPercent)
+	{
+		m_pRampUpTable = ((accelMillis > 0) && (accelProfile <= RAMP_SCURVE)) ? RAMP_TABLE[accelProfile] : NULL;
+		m_pRampDownTable = ((decelMillis > 0) && (decelProfile <= RAMP_SCURVE)) ? RAMP_TABLE[decelProfile] : NULL;
+		m_nRampUpMillis = accelMillis;
+		m_nRampDownMillis = decelMillis;
+		m_nCreepPercent = (creepPercent > 100) ? 100 : creepPercent;
+	}
+
+//scaleTravel - travel * to / from without the truncation of dividing first.  The whole and remainder parts are
+//scaled apart so nothing passes 32 bits - the remainder is under from, and timeouts are saved as 16 bit seconds
+	static unsigned long scaleTravel(unsigned long travel, unsigned long from, unsigned long to)
+	{
+		return (travel / from) * to + ((travel % from) * to) / from;
+	}
+
+//updateTravelTimes function - full travel time used by the position model
+//measured where there is an estimate, the other direction's estimate scaled by the timeouts, else the timeout itself
+	void IS_DCMotor_ShadeControl::updateTravelTimes()
+	{
+		m_lOpenTravelMillis = 1000UL * m_lOpenTimeLimit;
+		m_lCloseTravelMillis = 1000UL * m_lCloseTimeLimit;
+
+		if (m_lOpenTravelEstimate != 0) {
+			m_lOpenTravelMillis = m_lOpenTravelEstimate;
+		} else if ((m_lCloseTravelEstimate != 0) && (m_lCloseTimeLimit != 0)) {
+			m_lOpenTravelMillis = scaleTravel(m_lCloseTravelEstimate, m_lCloseTimeLimit, m_lOpenTimeLimit);
+		}
+
+		if (m_lCloseTravelEstimate != 0) {
+			m_lCloseTravelMillis = m_lCloseTravelEstimate;
+		} else if ((m_lOpenTravelEstimate != 0) && (m_lOpenTimeLimit != 0)) {
+			m_lCloseTravelMillis = scaleTravel(m_lOpenTravelEstimate, m_lOpenTimeLimit, m_lCloseTimeLimit);
+		}
+	}
+
+//moveTimeoutMillis function - the configured timeout until there is an estimate, then estimate plus margin under it
+	unsigned long IS_DCMotor_ShadeControl::moveTimeoutMillis(bool opening) const
+	{
+		unsigned long limit = 1000UL * (opening ? m_lOpenTimeLimit : m_lCloseTimeLimit);
+		if ((m_lOpenTravelEstimate == 0) && (m_lCloseTravelEstimate == 0)) return limit;
+
+		unsigned long travel = opening ? m_lOpenTravelMillis : m_lCloseTravelMillis;
+		unsigned long timeout = travel + (travel / 100) * CALIBRATION_MARGIN_PERCENT + m_nRampUpMillis + m_nRampDownMillis;
+		return (timeout < limit) ? timeout : limit;
+	}
+
+//calibrate function - a move just reached the end of travel, scale what it ran to a full travel sample
+	void IS_DCMotor_ShadeControl::calibrate(bool opened)
+	{
+		//the start has to be known, and the move long enough that switch timing noise doesn't matter
+		if (!m_bPositionKnown) return;
+		byte covered = opened ? 100 - m_nMoveStartPosition : m_nMoveStartPosition;
+		if (covered < CALIBRATION_MIN_PERCENT) return;
+
+		unsigned long sample = ((m_lTravelMillis + travelSince(millis())) * 100UL) / covered;
+		unsigned long &estimate = opened ? m_lOpenTravelEstimate : m_lCloseTravelEstimate;
+		if (estimate == 0) {
+			estimate = sample;
+		} else if (sample > estimate) {
+			estimate += (sample - estimate) / 4;
+		} else {
+			estimate -= (estimate - sample) / 4;
+		}
+		updateTravelTimes();
+		SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::calibrate - %s travel sample %lu estimate %lu", opened ? "open" : "close", sample, estimate);
+
+		//only a real change is worth a store write
+		unsigned long saved = opened ? m_lOpenTravelSaved : m_lCloseTravelSaved;
+		unsigned long change = (estimate > saved) ? estimate - saved : saved - estimate;
+		if ((saved == 0) || (change >= (saved / 100) * CALIBRATION_SAVE_PERCENT)) {
+			SHADE_LOG_INFO("%s %s travel %lu ms", getName().c_str(), opened ? "open" : "close", estimate);
+			WriteTimerValues(m_lOpenTimeLimit, m_lCloseTimeLimit);
+		}
+	}
+
+//sendPosition function
+	void IS_DCMotor_ShadeControl::sendPosition()
+	{
+		m_nLastReportedPosition = m_nPosition;
+		sendAttribute(ATTR_POSITION, m_nPosition);
+	}
+
+//stateName function - flash string for a state
+	PGM_P IS_DCMotor_ShadeControl::stateName(state s)
+	{
+		if (s > obstructed) s = unknown;
+		return (PGM_P)pgm_read_ptr(&STATE_STR[s]);
+	}
+
+//sendStatus function
+//builds "<name> <text>" or "<name> <text>:<value>" on the stack from the cached prefix - no heap use
+//while batching, "<text>[:<value>]" is added to the frame instead and sent by endBatch()
+	void IS_DCMotor_ShadeControl::sendStatus(PGM_P text, bool hasValue, unsigned long value)
+	{
+		char item[MSG_ITEM_SIZE];
+		strncpy_P(item, text, sizeof(item) - 1);
+		item[sizeof(item) - 1] = '\0';
+		size_t len = strlen(item);
+
+		//room for ':' plus 10 digits and the terminator
+		if (hasValue && (len + 12 <= sizeof(item))) {
+			item[len++] = ':';
+			ultoa(value, item + len, 10);
+			len += strlen(item + len);
+		}
+
+		sendItem(item, len);
+	}
+
+//sendAck function - "ack:<verb>" for a command taken from the hub
+	void IS_DCMotor_ShadeControl::sendAck(PGM_P verb)
+	{
+		char item[MSG_ITEM_SIZE];
+		strncpy_P(item, ATTR_ACK, sizeof(item) - 1);
+		size_t len = strlen_P(ATTR_ACK);
+		item[len++] = ':';
+		strncpy_P(item + len, verb, sizeof(item) - len - 1);
+		item[sizeof(item) - 1] = '\0';
+		sendItem(item, strlen(item));
+	}
+
+//sendItem function
+	void IS_DCMotor_ShadeControl::sendItem(const char *item, size_t len)
+	{
+		if (m_bBatching) {
+			//no room for ";<item>" - send what is there and start another frame
+			if ((m_nFrameLen > 0) && (m_nFrameLen + 1 + len >= sizeof(m_szFrame))) {
+				sendToHub(m_szFrame);
+				m_nFrameLen = 0;
+			}
+			if (m_nFrameLen == 0) {
+				memcpy(m_szFrame, m_szPrefix, m_nPrefixLen);
+				m_nFrameLen = m_nPrefixLen;
+			} else {
+				m_szFrame[m_nFrameLen++] = ';';
+			}
+			memcpy(m_szFrame + m_nFrameLen, item, len + 1);
+			m_nFrameLen += len;
+			return;
+		}
+
+		char buf[MSG_BUFFER_SIZE];
+		memcpy(buf, m_szPrefix, m_nPrefixLen);
+		memcpy(buf + m_nPrefixLen, item, len + 1);
+		sendToHub(buf);
+	}
+
+//beginBatch function - only when batched frames are enabled
+	void IS_DCMotor_ShadeControl::beginBatch()
+	{
+		if (m_bBatchFrames) m_bBatching = true;
+	}
+
+//endBatch function
+	void IS_DCMotor_ShadeControl::endBatch()
+	{
+		if (m_bBatching && (m_nFrameLen > 0)) sendToHub(m_szFrame);
+		m_bBatching = false;
+		m_nFrameLen = 0;
+	}
+
+//setDeadTime function
+	void IS_DCMotor_ShadeControl::setDeadTime(unsigned int deadMillis)
+	{
+		m_nDeadMillis = deadMillis;
+	}
+
+//enableBatchedFrames function
+	void IS_DCMotor_ShadeControl::enableBatchedFrames()
+	{
+		m_bBatchFrames = true;
+	}
+
+//enableCurrentSense function
+	void IS_DCMotor_ShadeControl::enableCurrentSense(byte pinCurrent, unsigned int stallLevel, unsigned int riseLevel, unsigned int blankMillis)
+	{
+		m_nPinCurrent = pinCurrent;
+		m_nStallLevel = stallLevel;
+		m_nRiseLevel = riseLevel;
+		m_nBlankMillis = blankMillis;
+		pinMode(m_nPinCurrent, INPUT);
+	}
+
+//currentStalled function
+//one sample per CURRENT_SAMPLE_MILLIS after the inrush blanking - the average and rise only count once the ring is full
+	bool IS_DCMotor_ShadeControl::currentStalled()
+	{
+		unsigned long now = millis();
+		if (((uint32_t)(now - m_lMoveStartMillis) < m_nBlankMillis) || ((uint32_t)(now - m_lLastSampleMillis) < CURRENT_SAMPLE_MILLIS)) return false;
+		m_lLastSampleMillis = now;
+
+		uint16_t sample = analogRead(m_nPinCurrent);
+		if (m_nCurrentCount == CURRENT_SAMPLES) {
+			m_lCurrentSum -= m_nCurrentRing[m_nCurrentHead];
+		} else {
+			m_nCurrentCount++;
+		}
+		m_nCurrentRing[m_nCurrentHead] = sample;
+		m_lCurrentSum += sample;
+		m_nCurrentHead = (m_nCurrentHead + 1) & (CURRENT_SAMPLES - 1);
+		if (m_nCurrentCount < CURRENT_SAMPLES) return false;
+
+		if (m_lCurrentSum >= (unsigned long)m_nStallLevel * CURRENT_SAMPLES) return true;
+		if (m_nRiseLevel == 0) return false;
+
+		//head is now the oldest sample - newer half average against older half average
+		unsigned long older = 0;
+		unsigned long newer = 0;
+		for (byte i = 0; i < CURRENT_SAMPLES / 2; i++) {
+			older += m_nCurrentRing[(m_nCurrentHead + i) & (CURRENT_SAMPLES - 1)];
+			newer += m_nCurrentRing[(m_nCurrentHead + CURRENT_SAMPLES / 2 + i) & (CURRENT_SAMPLES - 1)];
+		}
+		return (newer > older) && ((newer - older) >= (unsigned long)m_nRiseLevel * (CURRENT_SAMPLES / 2));
+	}
+
+//sendState function - every state change passes through here, so it also saves the state record
+	void IS_DCMotor_ShadeControl::sendState()
+	{
+		sendStatus(stateName(m_eCurrentState), false, 0);
+		saveState();
+	}
+
+//saveState function - queued, and dropped by ShadeStore when nothing changed (refresh).  A moving record is committed
+//at once, a reset in mid move must not find the at rest record it replaces
+	void IS_DCMotor_ShadeControl::saveState()
+	{
+		if (m_nStoreSlot == ShadeStore::NO_SLOT) return;
+
+		ShadeStateRecord record;
+		record.state = m_eCurrentState;
+		record.position = m_nPosition;
+		record.flags = (m_bPositionKnown ? STATE_FLAG_KNOWN : 0) | (((m_eCurrentState == opening) || (m_eCurrentState == closing)) ? STATE_FLAG_MOVING : 0);
+		ShadeStore::write(m_nStoreSlot, STORE_STATE, STATE_VERSION, &record, sizeof(record));
+		if (record.flags & STATE_FLAG_MOVING) ShadeStore::flush();
+	}
+
+//restoreState function - a record saved at rest, that the limit switches don't contradict
+	bool IS_DCMotor_ShadeControl::restoreState()
+	{
+		ShadeStateRecord record;
+		if (!ShadeStore::read(m_nStoreSlot, STORE_STATE, STATE_VERSION, &record, sizeof(record))) return false;
+		if ((record.flags & STATE_FLAG_MOVING) || (record.state == dummy) || (record.state == unknown) || (record.state > obstructed) || (record.position > 100)) return false;
+
+		//only called with neither switch active - a switch that should be and isn't means the shade was moved
+		if ((record.state == open) && (m_nPinSWOpened != 0)) return false;
+		if ((record.state == closed) && (m_nPinSWClosed != 0)) return false;
+
+		m_eCurrentState = (state)record.state;
+		if (record.flags & STATE_FLAG_KNOWN) {
+			setPosition(record.position);
+		}
+		SHADE_LOG_INFO("%s restored %s at %d", getName().c_str(), stateName(m_eCurrentState), record.position);
+		return true;
+	}
+
+//sendAttribute function
+	void IS_DCMotor_ShadeControl::sendAttribute(PGM_P attr, unsigned long value)
+	{
+		sendStatus(attr, true, value);
+	}
+
+//sendToHub function
+	void IS_DCMotor_ShadeControl::sendToHub(const char *msg)
+	{
+		m_sMsg = msg;
+
+		//nowhere to send it yet - init() reports the full state once the hub is up
+		if (Everything::SmartThing == NULL) {
+			m_Stats.messagesSuppressed++;
+			return;
+		}
+
+		m_Stats.messagesSent++;
+		Everything::sendSmartStringNow(m_sMsg);
+	}
+
+    void IS_DCMotor_ShadeControl::CancelTimer()
+	{
+		DeadlineScheduler::cancel(m_nTimer);
+	}
+
+//readPin function	
+	int IS_DCMotor_ShadeControl::readPin(byte pin)
+	{
+        if (pin == 0) {
+			return LOW;
+		} else {	
+			int value = digitalRead(pin);
+
+			if ((value == HIGH) && m_bInterruptActiveState) {
+ 				return HIGH;
+			} else if ((value == LOW) && !m_bInterruptActiveState) {
+				return HIGH;
+			} else {
+				return LOW;
+			}	
+		}
+    }	
+
+//ReadTimerValues
+//from this shade's ShadeStore slot - values above 150 tell init() to use the sketch values
+   void IS_DCMotor_ShadeControl::ReadTimerValues(unsigned int &open,unsigned int &close) {
+		ShadeSettings settings;
+
+		if (m_nStoreSlot == ShadeStore::NO_SLOT) m_nStoreSlot = ShadeStore::claimSlot(getName().c_str());
+
+		if (ShadeStore::read(m_nStoreSlot, STORE_SETTINGS, SETTINGS_VERSION, &settings, sizeof(settings))) {
+			open = settings.openTimeout;
+			close = settings.closeTimeout;
+			m_lOpenTravelEstimate = m_lOpenTravelSaved = settings.openTravelMillis;
+			m_lCloseTravelEstimate = m_lCloseTravelSaved = settings.closeTravelMillis;
+		} else if (ShadeStore::takeLegacyTimeouts(open, close)) {
+			//the old layout is gone from flash once begin() formatted - keep them in this shade's slot right away
+			WriteTimerValues(open, close);
+			ShadeStore::flush();
+		} else {
+			open = close = 0xFFFF;
+		}
+        SHADE_LOG_DEBUG("read eprom open:%u close:%u", open, close);
+
+   }
+
+//WriteTimerValues
+  void IS_DCMotor_ShadeControl::WriteTimerValues(unsigned int open,unsigned int close) {
+		ShadeSettings settings;
+                 SHADE_LOG_DEBUG("writing eeprom open:%u close:%u", open, close);
+
+		settings.openTimeout = open;
+		settings.closeTimeout = close;
+		settings.openTravelMillis = m_lOpenTravelSaved = m_lOpenTravelEstimate;
+		settings.closeTravelMillis = m_lCloseTravelSaved = m_lCloseTravelEstimate;
+		//queued - ShadeStore drops it if nothing changed and commits a burst of changes once
+		ShadeStore::write(m_nStoreSlot, STORE_SETTINGS, SETTINGS_VERSION, &settings, sizeof(settings));
+   }
+	
+}
+
+
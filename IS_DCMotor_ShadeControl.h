@@ -1,116 +1,448 @@
-//******************************************************************************************
-//  File: IS_DCMotor_ShadeControl.h
-//  Authors: Tim O'Callaghan based on Is_DoorControl.h
-//
-//  Summary:  IS_DCMotor_ShadeControl is a class which implements the SmartThings "Shade" device capability for a DC Motor.  It features
-//			  motor control and the use of a timer and optional switch for both open and close,although at least 1 switch should be used.
-//            When a switch is used the timer should be set so that in normal operation the switch will trip before the timer.
-//			  The inputs will be checked in update.  There is 2 outputs to control direction and a PWM 'analog' output to control speed for the L298N motor controller
-//            If you update the open or closed timeouts it will be stored in EEPROM so it won't be forgotten
-//			  It clones much from the st::Executor Class
-//
-//			  Create an instance of this class in your sketch's global variable section
-//			  For Example:  st::IS_DCMotor_ShadeControl sensor3(F("windowShade1"), PIN_OPEN_SWITCH, 60,0,70,LOW, true, PIN_MOTOR_OPEN,PIN_MOTOR_CLOSED,PIN_MOTORENABLE, 500,open, false);
-//
-//			  st::IS_DCMotor_ShadeControl() constructor requires the following arguments
-//				- String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
-//				- byte pinOpenSW - REQUIRED - the Arduino Pin to be used as a digital input for open switch   (if not used set to 0, then timer will stop for opening)
-//				- long openTimeLimit - REQUIRED - the number of seconds to run shade to open if no switch encountered
-//				- byte pinClosedSW - REQUIRED - the Arduino Pin to be used as a digital input for closed switch  (if not used set to 0, then time will stop down)
-//				- long closedTimeLimit - REQUIRED - the number of seconds to run shade to close if no switch encountered
-//				- bool interruptActiveState - REQUIRED - LOW or HIGH - determines which value indicates the interrupt is true for both inputs
-//				- bool internalPullup - REQUIRED - true == INTERNAL_PULLUP for both inputs
-//				- byte pinOutputOpen - REQUIRED - the Arduino Pin to be used as a digital output for open
-//				- byte pinOutputClose - REQUIRED - the Arduino Pin to be used as a digital output for close
-//				- byte pinMotorEnablePWM - REQUIRED - the Arduino Pin to be used as a digital PWM output -simulate analog
-//              - long PWMSpeedValue to output on PWM enable output
-//				- state desiredStartState - REQUIRED - (open or closed) -pick the one that has a real switch
-//				- bool invertOutputLogic - REQUIRED - determines whether the Arduino Digital Outputs should use inverted logic
-//
-//
-//  Change History:
-//
-//    Date        Who            What
-//    ----        ---            ----
-//    2020-12-31  Tim OC         Original Creation
-//
-//
-//******************************************************************************************
-
-#ifndef ST_IS_DCMOTOR_SHADECONTROL_H
-#define ST_IS_DCMOTOR_SHADECONTROL_H
-
-enum state {dummy=0,open=1,opening=2,closed=3,closing=4,unknown=5};
-enum command {Dummy=0,Open=1,Close=2, Stop=3};
-
-#include "Sensor.h"
-
-namespace st
-{
-	class IS_DCMotor_ShadeControl:public Sensor
-	{
-		private:
-			//inherits everything necessary from parent InterruptSensor Class for the Contact Sensor
-
-			//following are for the digital inputs
-			byte m_nPinSWOpened;                                        //set switch to 0 if no switch
-			byte m_nPinSWClosed;                                        //set switch to 0 if no switch
-			unsigned int m_lOpenTimeLimitUser;  //from caller
-			unsigned int m_lOpenTimeLimit;      //could be diff than caller if changed on groovy pages
-			unsigned int m_lCloseTimeLimitUser; //from caller
-			unsigned int m_lCloseTimeLimit;     //could be diff than caller if changed on groovy pages
-			unsigned long m_lTimeOperationDone;
-			bool m_bInternalPullup;
-            bool m_bInterruptActiveState; 
-
-    		//following are for the digital outputs
-     		byte m_npinMotorOutputOpen;
-			byte m_npinMotorOutputClose;
-            byte m_npinMotorOutputEnablePWM;
-			unsigned long m_lMotorPWMSpeed;
-			bool m_bInvertLogic;	//determines whether the Arduino Digital Output should use inverted logic
-
-			//current state open,opening,closed,closing,unknown
-			state m_eCurrentState;	
-			
-			bool m_bTimerPending;		//true if waiting on timer to expire
-            state m_eDesiredStartingState;
-			void controlMotor(command);	//function to Open, Close,Stop
-		    int readPin(byte pin);  //read digital input if pin is valid
-			void CancelTimer();
-			void ReadTimerValues(unsigned int &open,unsigned int &close);
-            void WriteTimerValues(unsigned int open,unsigned int close);
-
-		public:
-			//constructor - momentary output - called in your sketch's global variable declaration section
-        	IS_DCMotor_ShadeControl(const __FlashStringHelper *name, byte pinOpenSW,unsigned long openTimeLimit,byte pinClosedSW,long closedTimeLimit,  bool interruptActiveState, bool internalPullup, byte pinMotorOutputForward,byte pinMotorOutputReverse, byte pinMotorEnablePWM, unsigned long PWMSpeedValue, state desiredStartingState, bool invertOutputLogic);
-			
-			//destructor
-			virtual ~IS_DCMotor_ShadeControl();
-			
-			//initialization function
-			virtual void init();
-
-			//update function 
-			void update();
-
-			//SmartThings Shield data handler (receives command to turn "Open, Close or Stop the motor  (digital output)
-			virtual void beSmart(const String &str);
-
-			//called periodically by Everything class to ensure ST Cloud is kept consistent with the state of the contact sensor
-			virtual void refresh();
-/* 
-			//handles what to do when interrupt is triggered 
-			virtual void runInterrupt();
-
-			//handles what to do when interrupt is ended 
-			virtual void runInterruptEnded(); */
-
-			//gets
-			//virtual byte getPin() const { return m_nOutputPin; }
-
-	};
-}
-
-
+//******************************************************************************************
+//  File: IS_DCMotor_ShadeControl.h
+//  Authors: Tim O'Callaghan based on Is_DoorControl.h
+//
+//  Summary:  IS_DCMotor_ShadeControl is a class which implements the SmartThings "Shade" device capability for a DC Motor.  It features
+//			  motor control and the use of a timer and optional switch for both open and close,although at least 1 switch should be used.
+//            When a switch is used the timer should be set so that in normal operation the switch will trip before the timer.
+//			  The inputs will be checked in update.  There is 2 outputs to control direction and a PWM 'analog' output to control speed for the L298N motor controller
+//            If you update the open or closed timeouts it will be stored in EEPROM so it won't be forgotten.  Each shade
+//            has its own ShadeStore slot (found by device name), so several shades can share one board
+//			  It clones much from the st::Executor Class
+//
+//            Timing counters (update() cost, poll gap while moving, limit switch to motor stop latency and number of
+//            hub messages) are collected all the time and can be read with getStats() and cleared with resetStats().
+//            update() returns at once while the shade is not moving, so the counters cover moving polls only.  The update()
+//            cost is also kept as a cycle count histogram, and every move's duration is counted per direction.
+//            printMetrics() writes all of it for a /metrics page, and getShade() walks every shade on the board
+//
+//            Status messages are built in a fixed buffer from a "<name> " prefix cached at construction, and state and
+//            attribute names live in flash, so the shade code builds them without touching the heap.  ST_Anything's
+//            SmartThingsESP8266WiFi::send() takes the String by value, so the library still copies each one it sends
+//
+//            Optional batched frames - call enableBatchedFrames() after construction and init(), refresh() and every stop
+//            send one "<name> <state>;opentimeout:60;closetimeout:48;position:100" message instead of one per attribute.
+//            Needs the HubDuino Parent Ethernet driver from this repository, which splits the frame on ';'
+//
+//            "position:nn" (0 closed - 100 open) moves the shade part way.  Position is estimated from the run time against
+//            the full open/close travel times and re-zeroed whenever a limit switch trips (or a timeout ends a move on a
+//            side without a switch).  Position is reported while moving and a partial stop reports "partially_open".
+//
+//            Optional soft start/soft stop - call setRamp() after construction to ramp the PWM up and down along a linear or
+//            S-curve table.  Ramps are stepped from update() and never block.  Slowing down starts early as the estimated
+//            end of travel comes up: to a stop at a position target, or to a creep speed into the end so the limit switch
+//            still trips.  A limit switch always cuts the motor at once.  A stop from the hub ramps down.
+//				- rampProfile accelProfile - RAMP_NONE, RAMP_LINEAR or RAMP_SCURVE
+//				- unsigned int accelMillis - time from stopped to full PWMSpeedValue (0 = no soft start)
+//				- rampProfile decelProfile - RAMP_NONE, RAMP_LINEAR or RAMP_SCURVE
+//				- unsigned int decelMillis - time from full speed to stopped (0 = no soft stop)
+//				- byte creepPercent - percent of PWMSpeedValue to run into the end of travel at
+//
+//            Optional limit switch interrupts - call enableSwitchInterrupts() after construction.  A change on the switch
+//            at the end being driven towards cuts the direction outputs straight from the ISR, so stop latency no longer
+//            depends on how long the rest of the loop takes.  update() checks the switch again once the debounce time
+//            is up, finishes the stop, or resumes the move if it was only noise.  Polling stays on as a fallback.
+//				- unsigned long debounceMicros - time the switch is left to settle before update() believes it
+//
+//            Optional current sensing - call enableCurrentSense() after construction with the analog pin of a motor current
+//            sensor (shunt amplifier, ACS712...).  While moving, update() samples it every CURRENT_SAMPLE_MILLIS into a ring
+//            of CURRENT_SAMPLES and keeps a running average, and the rise of the newer half of the ring over the older half.
+//            Either one over its level stops the motor at once.  Near the end of travel being driven towards (or while the
+//            position is not known yet) the stall is taken as that end - a virtual limit switch, so a side without a switch
+//            no longer has to wait out its timeout.  Anywhere else the shade stops (state obstructed) and reports
+//            "partially_open" with "obstruction:1", and "obstruction:0" once it moves again - windowShade has no
+//            obstructed value.
+//				- byte pinCurrent - analog input
+//				- unsigned int stallLevel - analogRead() average that means the motor is stalled
+//				- unsigned int riseLevel - rise of the average within the ring that means it is being stopped (0 = off)
+//				- unsigned int blankMillis - time after a start the inrush is ignored
+//
+//            Travel times calibrate themselves.  Every move that a limit switch (or a current stall at the end) ends, and
+//            that covered at least CALIBRATION_MIN_PERCENT of the travel from a known position, gives a full travel time
+//            sample for that direction.  The samples are smoothed (1/4 weight for each new one) and used by the position
+//            model in place of the timeouts, and the move timeout becomes that estimate plus CALIBRATION_MARGIN_PERCENT
+//            and the ramp times, capped at the configured timeout.  A direction with no switch borrows the other
+//            direction's estimate scaled by the ratio of the configured timeouts.  Estimates are saved with the settings
+//            only when they moved by CALIBRATION_SAVE_PERCENT or more since the last save.
+//
+//            Warm restart - every state report also saves the state and position in a small ShadeStore record, marked
+//            as moving while the motor runs.  The moving record is committed at once, so a reset in mid move can't find
+//            the at rest record it replaced - only the at rest record waits for ShadeStore's deferred commit.  init()
+//            restores a record that was saved at rest (unless a limit switch contradicts it), reports it to the hub at
+//            once and does not move.  The shade only drives to desiredStartingState when there is no record or it was
+//            saved in mid move.
+//
+//            Commands - open, close and position:nn wait in a one entry command slot and a newer one replaces one still
+//            waiting, so a burst from an automation ends in its latest command only.  update() runs the slot: a move the
+//            other way (or to another target) is stopped first - with the soft stop if there is one - and the new one
+//            starts only once the motor has been off for the dead time, so the L298N never sees both directions at once.
+//            stop runs at once and empties the slot.  Every command taken is acknowledged with "<name> ack:<verb>".
+//            A command that would leave the shade as it is (close on a closed shade, close without a close switch while
+//            the state is unknown, stop at rest...) is not - it empties the slot and the shade reports its state.
+//				- unsigned int deadMillis - setDeadTime(), least time between the motor stopping and the next start
+//
+//            Safe before the hub - the constructor drives the motor outputs off, so a global instance has the bridge
+//            off before setup() runs.  Call safeStart() from setup() to read the limit switches, then update() from
+//            loop() until the hub connection is up.  Messages are dropped (see messagesSuppressed) while
+//            Everything::SmartThing is not set yet, init() reports everything once the hub is there.
+//
+//			  Create an instance of this class in your sketch's global variable section
+//			  For Example:  st::IS_DCMotor_ShadeControl sensor3(F("windowShade1"), PIN_OPEN_SWITCH, 60,0,70,LOW, true, PIN_MOTOR_OPEN,PIN_MOTOR_CLOSED,PIN_MOTORENABLE, 500,open, false);
+//
+//			  st::IS_DCMotor_ShadeControl() constructor requires the following arguments
+//				- String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
+//				- byte pinOpenSW - REQUIRED - the Arduino Pin to be used as a digital input for open switch   (if not used set to 0, then timer will stop for opening)
+//				- long openTimeLimit - REQUIRED - the number of seconds to run shade to open if no switch encountered
+//				- byte pinClosedSW - REQUIRED - the Arduino Pin to be used as a digital input for closed switch  (if not used set to 0, then time will stop down)
+//				- long closedTimeLimit - REQUIRED - the number of seconds to run shade to close if no switch encountered
+//				- bool interruptActiveState - REQUIRED - LOW or HIGH - determines which value indicates the interrupt is true for both inputs
+//				- bool internalPullup - REQUIRED - true == INTERNAL_PULLUP for both inputs
+//				- byte pinOutputOpen - REQUIRED - the Arduino Pin to be used as a digital output for open
+//				- byte pinOutputClose - REQUIRED - the Arduino Pin to be used as a digital output for close
+//				- byte pinMotorEnablePWM - REQUIRED - the Arduino Pin to be used as a digital PWM output -simulate analog
+//              - long PWMSpeedValue to output on PWM enable output
+//				- state desiredStartState - REQUIRED - (open or closed) -pick the one that has a real switch
+//				- bool invertOutputLogic - REQUIRED - determines whether the Arduino Digital Outputs should use inverted logic
+//
+//
+//  Change History:
+//
+//    Date        Who            What
+//    ----        ---            ----
+//    2020-12-31  Tim OC         Original Creation
+//
+//
+//******************************************************************************************
+
+#ifndef ST_IS_DCMOTOR_SHADECONTROL_H
+#define ST_IS_DCMOTOR_SHADECONTROL_H
+
+enum state {dummy=0,open=1,opening=2,closed=3,closing=4,unknown=5,partial=6,obstructed=7};
+enum command {Dummy=0,Open=1,Close=2, Stop=3};
+enum rampProfile {RAMP_NONE=0,RAMP_LINEAR=1,RAMP_SCURVE=2};
+
+#include "Sensor.h"
+#include "DeadlineScheduler.h"
+#include "ShadeMetrics.h"
+
+//ESP8266/ESP32 need interrupt handlers in IRAM
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+namespace st
+{
+	//moves in one direction - controlMotor(Open/Close) to controlMotor(Stop)
+	struct ShadeMoveStats
+	{
+		unsigned long moves;
+		unsigned long millisLast;
+		unsigned long millisMax;
+		unsigned long millisTotal;
+	};
+
+	//timing counters kept by each shade - all times in microseconds
+	struct ShadeStats
+	{
+		unsigned long updateCalls;          //number of update() calls
+		unsigned long updateMicrosTotal;    //total time spent in update()
+		unsigned long updateMicrosMax;      //slowest single update()
+		unsigned long pollGapMicrosMax;     //longest time between two update() calls while the motor was running
+		unsigned long stopLatencyMicros;    //last limit switch stop - previous poll to motor outputs cut (worst case trip to stop)
+		unsigned long stopLatencyMicrosMax; //worst limit switch stop seen
+		unsigned long switchStops;          //number of moves ended by a limit switch
+		unsigned long messagesSent;         //number of messages sent to the hub
+		unsigned long isrStops;             //limit switch stops made by the switch interrupt
+		unsigned long isrGlitches;          //switch interrupts that were not confirmed after debounce
+		ShadeHistogram updateCycles;        //update() cost in CPU cycles
+		ShadeMoveStats openMoves;
+		ShadeMoveStats closeMoves;
+		unsigned long obstructions;         //moves stopped by motor current away from the end of travel
+		unsigned long virtualLimits;        //moves ended by a stall at the end of travel
+		unsigned long messagesSuppressed;   //messages dropped because the hub connection was not up yet
+		unsigned long commandsAccepted;     //hub commands acknowledged
+		unsigned long commandsCoalesced;    //queued commands replaced by a newer one before they ran
+		unsigned long commandPreemptions;   //moves stopped to run a newer command
+		unsigned long commandsRejected;     //hub commands that would not have moved the shade, answered with the state
+	};
+
+	//what each shade keeps in its ShadeStore slot - bump SETTINGS_VERSION when this changes
+	struct ShadeSettings
+	{
+		uint16_t openTimeout;               //seconds
+		uint16_t closeTimeout;              //seconds
+		uint32_t openTravelMillis;          //calibrated full travel time, 0 until measured
+		uint32_t closeTravelMillis;
+	};
+
+	//last reported state, saved so a restart doesn't have to home the shade - bump STATE_VERSION when this changes
+	struct ShadeStateRecord
+	{
+		byte state;
+		byte position;
+		byte flags;                         //STATE_FLAG_...
+	};
+
+	class IS_DCMotor_ShadeControl:public Sensor
+	{
+		private:
+			//inherits everything necessary from parent InterruptSensor Class for the Contact Sensor
+
+			//following are for the digital inputs
+			byte m_nPinSWOpened;                                        //set switch to 0 if no switch
+			byte m_nPinSWClosed;                                        //set switch to 0 if no switch
+			unsigned int m_lOpenTimeLimitUser;  //from caller
+			unsigned int m_lOpenTimeLimit;      //could be diff than caller if changed on groovy pages
+			unsigned int m_lCloseTimeLimitUser; //from caller
+			unsigned int m_lCloseTimeLimit;     //could be diff than caller if changed on groovy pages
+			byte m_nTimer;                      //DeadlineScheduler id for the move timeout
+			bool m_bInternalPullup;
+            bool m_bInterruptActiveState; 
+
+    		//following are for the digital outputs
+     		byte m_npinMotorOutputOpen;
+			byte m_npinMotorOutputClose;
+            byte m_npinMotorOutputEnablePWM;
+			unsigned long m_lMotorPWMSpeed;
+			bool m_bInvertLogic;	//determines whether the Arduino Digital Output should use inverted logic
+
+			//current state open,opening,closed,closing,unknown
+			state m_eCurrentState;	
+			
+			bool timerPending() const { return DeadlineScheduler::isArmed(m_nTimer); }   //true if waiting on timer to expire
+            state m_eDesiredStartingState;
+			void controlMotor(command);	//function to Open, Close,Stop
+		    int readPin(byte pin);  //read digital input if pin is valid
+			void CancelTimer();
+			void ReadTimerValues(unsigned int &open,unsigned int &close);
+            void WriteTimerValues(unsigned int open,unsigned int close);
+			//outbound messages
+			static const byte MSG_BUFFER_SIZE = 96;
+			static const byte MSG_ITEM_SIZE = 24;       //"<text>:<value>" - longest is closetimeout:4294967295
+			char m_szPrefix[32];                //"<name> " cached at construction
+			byte m_nPrefixLen;
+			String m_sMsg;                      //reserved once, reused for every message
+			void sendStatus(PGM_P text, bool hasValue, unsigned long value);
+			void sendState();                   //"<name> <state>"
+			void sendAttribute(PGM_P attr, unsigned long value);  //"<name> <attr>:<value>"
+			void sendToHub(const char *msg);    //send a message to the hub and count it
+			void sendItem(const char *item, size_t len);  //"<item>" alone, or added to the frame while batching
+			void sendAck(PGM_P verb);           //"<name> ack:<verb>"
+			bool m_bBatchFrames;                //enableBatchedFrames() called
+			bool m_bBatching;                   //between beginBatch() and endBatch()
+			char m_szFrame[MSG_BUFFER_SIZE];    //"<name> <item>;<item>..." being built
+			byte m_nFrameLen;
+			void beginBatch();
+			void endBatch();                    //sends the frame built since beginBatch()
+
+			//hub commands - beSmart() looks the verb up in s_Verbs and calls its handler with the text after ':' (or NULL)
+			enum verbQueue {VerbNow=0, VerbQueued=1, VerbClearsQueue=2};
+			struct ShadeVerb
+			{
+				PGM_P name;
+				void (IS_DCMotor_ShadeControl::*handler)(const char *arg);
+				bool needsArg;
+				verbQueue queue;                //run at once, wait in the command slot, or run at once and empty the slot
+			};
+			static const ShadeVerb s_Verbs[];
+			void cmdOpen(const char *arg);
+			void cmdClose(const char *arg);
+			void cmdStop(const char *arg);
+			void cmdSetOpenTimeout(const char *arg);
+			void cmdSetCloseTimeout(const char *arg);
+			void cmdPosition(const char *arg);
+			bool canOpen();                     //open/close guards, shared with position:0 and position:100
+			bool canClose();
+			command positionMove(unsigned long target);   //Open, Close, or Stop when already there
+			byte findVerb(const char *verb, const char *&arg);
+			bool willRun(byte verb, const char *arg);     //false when the command would leave the shade as it is
+			void sendRestingState();            //state and known position in one frame
+
+			//command slot - see top of file
+			static const byte NO_VERB = 0xFF;
+			static const byte QUEUED_ARG_SIZE = 8;
+			static const unsigned int DEFAULT_DEAD_MILLIS = 250;
+			byte m_nQueuedVerb;                 //s_Verbs index waiting to run, or NO_VERB
+			char m_szQueuedArg[QUEUED_ARG_SIZE];
+			unsigned int m_nDeadMillis;
+			unsigned long m_lStopMillis;        //millis() the motor outputs were last turned off
+			void runQueue();
+
+			//position model - 0 closed to 100 open
+			static const byte NO_TARGET = 0xFF;               //full move, run to the switch or timeout
+			static const unsigned long POSITION_REPORT_MILLIS = 1000;  //live position report interval while moving
+			byte m_nPosition;                   //position when last stopped
+			bool m_bPositionKnown;              //false until a switch or a full timed move has zeroed it
+			byte m_nMoveStartPosition;
+			unsigned long m_lTravelMillis;      //full speed equivalent run time this move, up to m_lLastTravelMillis
+			unsigned long m_lLastTravelMillis;  //millis() of the last duty change
+			byte m_nTargetPosition;             //stop here, or NO_TARGET
+			byte m_nLastReportedPosition;
+			unsigned long m_lLastPositionReportMillis;
+			unsigned long m_lOpenTravelMillis;  //full travel time closed to open
+			unsigned long m_lCloseTravelMillis; //full travel time open to closed
+			void setPosition(byte pos);
+			byte estimatePosition() const;
+			void stopPartWay();
+			unsigned long travelSince(unsigned long now) const;
+			void updateTravelTimes();
+			void sendPosition();
+
+			//PWM ramps
+			enum rampPhase {RampNone=0,RampUp=1,RampDown=2};
+			unsigned long m_lDuty;              //PWM currently on the enable pin
+			rampPhase m_eRampPhase;
+			byte m_nRampStep;
+			unsigned long m_lRampStepMillis;
+			unsigned long m_lRampFromDuty;
+			unsigned long m_lRampFloorDuty;
+			bool m_bStopAtRampEnd;              //stop the motor once the ramp down is done
+			const byte *m_pRampUpTable;         //PROGMEM table or NULL for full speed at once
+			const byte *m_pRampDownTable;       //PROGMEM table or NULL for hard stops only
+			unsigned int m_nRampUpMillis;
+			unsigned int m_nRampDownMillis;
+			byte m_nCreepPercent;
+			void setDuty(unsigned long duty);
+			void startDuty();
+			void beginRampDown(unsigned long floorDuty);
+			void runRamp();
+
+			//limit switch interrupts
+			static const byte MAX_ISR_SHADES = 4;
+			static IS_DCMotor_ShadeControl* s_pIsrShades[MAX_ISR_SHADES];
+			static byte s_nIsrShades;
+			bool m_bSwitchInterrupts;
+			unsigned long m_lDebounceMicros;
+			volatile byte m_nIsrArmedPin;       //switch the ISR watches, 0 when not moving
+			volatile byte m_nIsrTrippedPin;     //set by the ISR when it cut the motor
+			volatile unsigned long m_lIsrEdgeMicros;
+			volatile unsigned long m_lIsrCutMicros;  //edge to outputs cut
+			void armSwitchInterrupt(byte pin);
+			static void switchISR();
+			void switchEdge();
+
+			//motor current
+			static const byte CURRENT_SAMPLES = 8;          //power of two
+			static const byte CURRENT_SAMPLE_MILLIS = 25;
+			static const byte END_ZONE_PERCENT = 10;        //a stall this close to the end being driven to is the end
+			byte m_nPinCurrent;                 //0 when not used
+			unsigned int m_nStallLevel;
+			unsigned int m_nRiseLevel;
+			unsigned int m_nBlankMillis;
+			uint16_t m_nCurrentRing[CURRENT_SAMPLES];
+			byte m_nCurrentHead;
+			byte m_nCurrentCount;
+			unsigned long m_lCurrentSum;
+			unsigned long m_lLastSampleMillis;
+			bool currentStalled();              //takes a sample when one is due - true when the motor is stalled
+
+			//travel time calibration - see top of file
+			static const byte CALIBRATION_MIN_PERCENT = 50;
+			static const byte CALIBRATION_MARGIN_PERCENT = 20;
+			static const byte CALIBRATION_SAVE_PERCENT = 5;
+			unsigned long m_lOpenTravelEstimate;   //smoothed full speed travel time, 0 until measured
+			unsigned long m_lCloseTravelEstimate;
+			unsigned long m_lOpenTravelSaved;      //estimates as last written to the store
+			unsigned long m_lCloseTravelSaved;
+			void calibrate(bool opened);           //end of travel reached - call before setPosition()
+			unsigned long moveTimeoutMillis(bool opening) const;
+
+			//persistent settings
+			static const byte STORE_SETTINGS = 0;     //ShadeStore record kinds
+			static const byte SETTINGS_VERSION = 2;
+			static const byte STORE_STATE = 1;
+			static const byte STATE_VERSION = 1;
+			static const byte STATE_FLAG_KNOWN = 0x01;      //position is valid
+			static const byte STATE_FLAG_MOVING = 0x02;     //saved while the motor ran - position can't be trusted
+			void saveState();
+			bool restoreState();                //true when a record saved at rest was restored
+			byte m_nStoreSlot;                  //ShadeStore slot, claimed on the first read
+
+			ShadeStats m_Stats;
+			unsigned long m_lLastPollMicros;    //micros() at the start of the previous update()
+			command m_eMoveCommand;             //Open or Close while the motor runs, else Stop
+			unsigned long m_lMoveStartMillis;
+
+			//every shade on the board, in construction order
+			static const byte MAX_SHADES = 8;
+			static_assert(MAX_SHADES <= DeadlineScheduler::MAX_DEADLINES, "every shade needs its own DeadlineScheduler deadline");
+			static IS_DCMotor_ShadeControl* s_pShades[MAX_SHADES];
+			static byte s_nShades;
+
+		public:
+			static const byte RAMP_STEPS = 16;  //entries in each ramp table
+
+			//constructor - momentary output - called in your sketch's global variable declaration section
+        	IS_DCMotor_ShadeControl(const __FlashStringHelper *name, byte pinOpenSW,unsigned long openTimeLimit,byte pinClosedSW,long closedTimeLimit,  bool interruptActiveState, bool internalPullup, byte pinMotorOutputForward,byte pinMotorOutputReverse, byte pinMotorEnablePWM, unsigned long PWMSpeedValue, state desiredStartingState, bool invertOutputLogic);
+			
+			//destructor
+			virtual ~IS_DCMotor_ShadeControl();
+			
+			//initialization function
+			virtual void init();
+
+			//motor off and limit switches read, before the hub is up - see top of file
+			void safeStart();
+
+			//update function 
+			void update();
+
+			//SmartThings Shield data handler (receives command to turn "Open, Close or Stop the motor  (digital output)
+			virtual void beSmart(const String &str);
+
+			//runs one hub command without the device name - "close", "position:40"...
+			void runCommand(const char *verb);
+
+			//false when runCommand() would only report the state - already there, nothing to stop
+			bool wouldRun(const char *verb);
+
+			//hub name of a state, in flash
+			static PGM_P stateName(state s);
+
+			//called periodically by Everything class to ensure ST Cloud is kept consistent with the state of the contact sensor
+			virtual void refresh();
+/* 
+			//handles what to do when interrupt is triggered 
+			virtual void runInterrupt();
+
+			//handles what to do when interrupt is ended 
+			virtual void runInterruptEnded(); */
+
+			//gets
+			//virtual byte getPin() const { return m_nOutputPin; }
+			const ShadeStats& getStats() const { return m_Stats; }
+			state getState() const { return m_eCurrentState; }
+			byte getPosition() const { return estimatePosition(); }
+			bool isPositionKnown() const { return m_bPositionKnown; }
+			bool isCommandQueued() const { return m_nQueuedVerb != NO_VERB; }
+
+			//clears the timing counters
+			void resetStats();
+
+			//writes the counters as shade="<name>" metrics - see ShadeMetrics
+			void printMetrics(Print &out) const;
+
+			//shades constructed so far
+			static byte getShadeCount() { return s_nShades; }
+			static IS_DCMotor_ShadeControl* getShade(byte i) { return (i < s_nShades) ? s_pShades[i] : NULL; }
+
+			//soft start/soft stop - see top of file
+			void setRamp(rampProfile accelProfile, unsigned int accelMillis, rampProfile decelProfile, unsigned int decelMillis, byte creepPercent);
+
+			//limit switch interrupts - see top of file
+			void enableSwitchInterrupts(unsigned long debounceMicros);
+
+			//dead time between the motor stopping and the next start - see top of file
+			void setDeadTime(unsigned int deadMillis);
+
+			//batched frames - see top of file
+			void enableBatchedFrames();
+
+			//motor current stall detection - see top of file
+			void enableCurrentSense(byte pinCurrent, unsigned int stallLevel, unsigned int riseLevel, unsigned int blankMillis);
+
+	};
+}
+
+
 #endif
\ No newline at end of file
@@ -1,244 +1,480 @@
-//******************************************************************************************
-// File: ST_Anything_DCMotor_Shades.ino
-// Authors: Dan G Ogorchock & Daniel J Ogorchock (Father and Son)
-//
-// Summary: This Arduino Sketch, along with the ST_Anything library and the revised SmartThings
-//          library, demonstrates the ability of one NodeMCU ESP8266 to
-//          implement a multi input/output custom device for integration into SmartThings.
-//
-//          The ST_Anything library takes care of all of the work to schedule device updates
-//          as well as all communications with the NodeMCU ESP8266’s WiFi.
-//
-//          IS_DCMotor_ShadeControl implements the following Hubitat Shade Capabilities with a DC motor, DC motor controller and mechanical switches
-//
-//
-// Change History:
-//+
-//    Date        Who            What
-//    ----        ---            ----
-//    2019-10-31  Dan Ogorchock  Original Creation
-//    2022-01-20  Tim O          Modified for DC Shade, Illuminance and Motion
-//    2022-01-21  Tim O          use map on illuminance so 0 is dark and 100 is brightest
-//******************************************************************************************
-//******************************************************************************************
-// SmartThings Library for ESP8266WiFi
-//******************************************************************************************
-#include <SmartThingsESP8266WiFi.h>
-
-//******************************************************************************************
-// O T A 
-//******************************************************************************************
-#include <ArduinoOTA.h>
-#include <ESP8266WiFi.h>
-#include <WiFiClient.h>
-#include <ESP8266WebServer.h>
-#include <ESP8266mDNS.h>
-#include <ESP8266HTTPUpdateServer.h>
-const char* host = "shade-webupdate";
-//const char* ssid = STASSID;
-//const char* password = STAPSK;
-ESP8266WebServer httpServer(80);
-ESP8266HTTPUpdateServer httpUpdater;
-
-//******************************************************************************************
-// ST_Anything Library
-//******************************************************************************************
-#include <Constants.h> //Constants.h is designed to be modified by the end user to adjust behavior of the ST_Anything library
-#include <Device.h> //Generic Device Class, inherited by Sensor and Executor classes
-#include <Sensor.h> //Generic Sensor Class, typically provides data to ST Cloud (e.g. Temperature, Motion, etc…)
-#include <Executor.h> //Generic Executor Class, typically receives data from ST Cloud (e.g. Switch)
-#include <InterruptSensor.h> //Generic Interrupt "Sensor" Class, waits for change of state on digital input
-#include <PollingSensor.h> //Generic Polling "Sensor" Class, polls Arduino pins periodically
-#include <Everything.h> //Master Brain of ST_Anything library that ties everything together and performs ST Shield communications
-
-#include <IS_DCMotor_ShadeControl.h> //Implements DC Motor shade controller
-#include <PS_Illuminance.h> //Illuminance
-#include <IS_Motion.h>  //Motion
-//*************************************************************************************************
-//NodeMCU v1.0 ESP8266-12e Pin Definitions (makes it much easier as these match the board markings)
-//                    -Do NOT uncomment these statements as they are defined by the board manager
-//*************************************************************************************************
-#define LED_BUILTIN 16
-#define BUILTIN_LED 16
-
-#define D0 16  //no internal pullup resistor
-#define D1  5
-#define D2  4
-#define D3  0  //must not be pulled low during power on/reset, toggles value during boot
-#define D4  2  //must not be pulled low during power on/reset, toggles value during boot
-#define D5 14
-#define D6 12
-#define D7 13
-#define D8 15  //must not be pulled high during power on/reset
-
-//******************************************************************************************
-//Define which Arduino Pins will be used for each device
-//******************************************************************************************
-#define PIN_ILLUMINANCE   A0
-#define PIN_OPEN_SWITCH   D1
-#define PIN_CLOSE_SWITCH  0     // not using close switch  D2
-#define PIN_MOTION        D4    //was D3
-#define PIN_MOTOR_ENABLE  D5
-#define PIN_MOTOR_OPEN    D7
-#define PIN_MOTOR_CLOSE   D6
-//******************************************************************************************
-//ESP8266 WiFi Information
-//******************************************************************************************
-String str_ssid     = "xxxxxxxxxx";                           //  <---You must edit this line!
-String str_password = "xxxxxxxxxx";                   //  <---You must edit this line!
-IPAddress ip(192, 168, 1, 143);       //Device IP Address       //  <---You must edit this line!
-IPAddress gateway(192, 168, 1, 1);    //Router gateway          //  <---You must edit this line!
-IPAddress dnsserver(192, 168, 1, 1);  //DNS server              //  <---You must edit this line!
-IPAddress subnet(255, 255, 255, 0);   //LAN subnet mask         //  <---You must edit this line!
-const unsigned int serverPort = 8090; // port to run the http server on
-
-// Hubitat Hub Information
-IPAddress hubIp(192, 168, 1, 118);    // hubitat hub ip         //  <---You must edit this line!
-const unsigned int hubPort = 39501;   // hubitat hub port
-
-//******************************************************************************************
-//st::Everything::callOnMsgSend() optional callback routine.  This is a sniffer to monitor 
-//    data being sent to ST.  This allows a user to act on data changes locally within the 
-//    Arduino sktech.
-//******************************************************************************************
-void callback(const String &msg)
-{
-}
-
-//******************************************************************************************
-//Arduino Setup() routine
-//******************************************************************************************
-void setup() 
-{
-
-  
-//******************************************************************************************
-// O T A  Stuff
-//******************************************************************************************
-  Serial.begin(115200);
-  Serial.println();
-  Serial.println("Setting up OTA..");
-  WiFi.mode(WIFI_AP_STA);
-  WiFi.begin(str_ssid, str_password);
-
-  while (WiFi.waitForConnectResult() != WL_CONNECTED) {
-    WiFi.begin(str_ssid, str_password);
-    Serial.println("WiFi failed, retrying.");
-  }
-
-  MDNS.begin(host);
-
-  httpUpdater.setup(&httpServer);
-  httpServer.begin();
-  Serial.println("MDSN.addService..");
-  MDNS.addService("http", "tcp", 80);
-  Serial.printf("HTTPUpdateServer ready! Open http://%s.local/update in your browser\n", host);
-  Serial.println("Fixing MAP on window light sensor..");
-  delay(3000);
-  //******************************************************************************************
-  //Declare each Device that is attached to the Arduino
-  //  Notes: - For documentation on each device's constructor arguments below, please refer to  
-  //           the corresponding header (.h) and program (.cpp) files.
-  //         - The new Composite Device Handler is comprised of a Parent DH and various Child
-  //           DH's.  The names used below MUST not be changed for the Automatic Creation of
-  //           child devices to work properly.  Simply increment the number by +1 for each duplicate
-  //           device (e.g. valve1, valve2, valve3, etc...)  You can rename the Child Devices
-  //           to match your specific use case in the Hubitat IDE  
-  //******************************************************************************************
- //       st::IS_DCMotor_ShadeControl() constructor requires the following arguments
-//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
-//        - byte pinOpenSW - REQUIRED - the Arduino Pin to be used as a digital input for open switch   (if not used set to 0, then shade will stop after openTimeLimit and be open)
-//        - long openTimeLimit - REQUIRED - the number of seconds to run shade to open if no switch encountered
-//        - byte pinClosedSW - REQUIRED - the Arduino Pin to be used as a digital input for closed switch  (if not used set to 0, then shade will stop after closeTimeLimit and be closed)
-//        - long closedTimeLimit - REQUIRED - the number of seconds to run shade to close if no switch encountered
-//        - bool interruptActiveState - REQUIRED - LOW or HIGH - determines which value indicates the interrupt is true for both inputs
-//        - bool internalPullup - REQUIRED - true == INTERNAL_PULLUP for both inputs
-//        - byte pinOutputOpen - REQUIRED - the Arduino Pin to be used as a digital output for open
-//        - byte pinOutputClose - REQUIRED - the Arduino Pin to be used as a digital output for close
-//        - byte pinMotorEnablePWM - REQUIRED - the Arduino Pin to be used as a digital PWM output -simulate analog
-//        - long PWMSpeedValue to output on PWM enable output
-//        - state desiredStartState - REQUIRED - (open or closed) -pick the one that has a real switch
-//        - bool invertOutputLogic - REQUIRED - determines whether the Arduino Digital Outputs should use inverted logic
-
-
-
-  static st::IS_DCMotor_ShadeControl sensor1(F("windowDCShade1"), PIN_OPEN_SWITCH,60,PIN_CLOSE_SWITCH,48, LOW, true, PIN_MOTOR_OPEN,PIN_MOTOR_CLOSE, PIN_MOTOR_ENABLE, 1000, open, false);
-
-//        st::PS_Illuminance() constructor requires the following arguments
-//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
-//        - long interval - REQUIRED - the polling interval in seconds
-//        - long offset - REQUIRED - the polling interval offset in seconds - used to prevent all polling sensors from executing at the same time
-//        - byte pin - REQUIRED - the Arduino Pin to be used as a digital output
-//        - int s_l - OPTIONAL - first argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
-//        - int s_h - OPTIONAL - second argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
-//        - int m_l - OPTIONAL - third argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
-//        - int m_h - OPTIONAL - fourth argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
- 
- static st::PS_Illuminance sensor2(F("illuminance1"), 900, 0, PIN_ILLUMINANCE, 0, 1023, 100,0);
-
-//        st::IS_Motion() constructor requires the following arguments
-//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
-//        - byte pin - REQUIRED - the Arduino Pin to be used as a digital output
-//        - bool iState - OPTIONAL - LOW or HIGH - determines which value indicates the interrupt is true
-//        - bool internalPullup - OPTIONAL - true == INTERNAL_PULLUP
-//        - long numReqCounts - OPTIONAL - number of counts before changing state of input (prevent false alarms)
-//        - long inactiveTimeout - OPTIONAL - number of milliseconds motion must be inactive before sending update 
-
-static st::IS_Motion sensor3(F("motion1"), PIN_MOTION, HIGH, false, 1,500);
-
-  //*****************************************************************************
-  //  Configure debug print output from each main class 
-  //  -Note: Set these to "false" if using Hardware Serial on pins 0 & 1
-  //         to prevent communication conflicts with the ST Shield communications
-  //*****************************************************************************
-  st::Everything::debug=true;
-  st::Executor::debug=true;
-  st::Device::debug=true;
-  st::Sensor::debug=true;
-  st::PollingSensor::debug=true;
-  st::InterruptSensor::debug=true;
-
-  //*****************************************************************************
-  //Initialize the "Everything" Class
-  //*****************************************************************************
-
-  //Initialize the optional local callback routine (safe to comment out if not desired)
-  st::Everything::callOnMsgSend = callback;
-  
-  //Create the SmartThings ESP8266WiFi Communications Object
-    //STATIC IP Assignment - Recommended
-    st::Everything::SmartThing = new st::SmartThingsESP8266WiFi(str_ssid, str_password, ip, gateway, subnet, dnsserver, serverPort, hubIp, hubPort, st::receiveSmartString);
- 
-  //Run the Everything class' init() routine which establishes WiFi communications with Hubitat Hub
-  st::Everything::init();
-  
-  //*****************************************************************************
-  //Add each sensor to the "Everything" Class
-  //*****************************************************************************
-  st::Everything::addSensor(&sensor1);
-  st::Everything::addSensor(&sensor2);
-  st::Everything::addSensor(&sensor3);
-
-  //*****************************************************************************
-  //Initialize each of the devices which were added to the Everything Class
-  //*****************************************************************************
-  st::Everything::initDevices();
-  
-}
-
-//******************************************************************************************
-//Arduino Loop() routine
-//******************************************************************************************
-void loop()
-{
-  //*****************************************************************************
-  //Execute the Everything run method which takes care of "Everything"
-  //*****************************************************************************
-  st::Everything::run();
-
-  //*****************************************************************************
-  //  O T A
-  //*****************************************************************************
-  httpServer.handleClient();
-  MDNS.update();
-}
+//******************************************************************************************
+// File: ST_Anything_DCMotor_Shades.ino
+// Authors: Dan G Ogorchock & Daniel J Ogorchock (Father and Son)
+//
+// Summary: This Arduino Sketch, along with the ST_Anything library and the revised SmartThings
+//          library, demonstrates the ability of one NodeMCU ESP8266 to
+//          implement a multi input/output custom device for integration into SmartThings.
+//
+//          The ST_Anything library takes care of all of the work to schedule device updates
+//          as well as all communications with the NodeMCU ESP8266’s WiFi.
+//
+//          IS_DCMotor_ShadeControl implements the following Hubitat Shade Capabilities with a DC motor, DC motor controller and mechanical switches
+//
+//
+// Change History:
+//+
+//    Date        Who            What
+//    ----        ---            ----
+//    2019-10-31  Dan Ogorchock  Original Creation
+//    2022-01-20  Tim O          Modified for DC Shade, Illuminance and Motion
+//    2022-01-21  Tim O          use map on illuminance so 0 is dark and 100 is brightest
+//******************************************************************************************
+//******************************************************************************************
+// SmartThings Library for ESP8266WiFi
+//******************************************************************************************
+#include <SmartThingsESP8266WiFi.h>
+
+//******************************************************************************************
+// O T A 
+//******************************************************************************************
+#include <ArduinoOTA.h>
+#include <ESP8266WiFi.h>
+#include <WiFiClient.h>
+#include <ESP8266WebServer.h>
+#include <ESP8266mDNS.h>
+#include <ESP8266HTTPUpdateServer.h>
+const char* host = "shade-webupdate";
+//const char* ssid = STASSID;
+//const char* password = STAPSK;
+ESP8266WebServer httpServer(80);
+ESP8266HTTPUpdateServer httpUpdater;
+
+//******************************************************************************************
+// ST_Anything Library
+//******************************************************************************************
+#include <Constants.h> //Constants.h is designed to be modified by the end user to adjust behavior of the ST_Anything library
+#include <Device.h> //Generic Device Class, inherited by Sensor and Executor classes
+#include <Sensor.h> //Generic Sensor Class, typically provides data to ST Cloud (e.g. Temperature, Motion, etc…)
+#include <Executor.h> //Generic Executor Class, typically receives data from ST Cloud (e.g. Switch)
+#include <InterruptSensor.h> //Generic Interrupt "Sensor" Class, waits for change of state on digital input
+#include <PollingSensor.h> //Generic Polling "Sensor" Class, polls Arduino pins periodically
+#include <Everything.h> //Master Brain of ST_Anything library that ties everything together and performs ST Shield communications
+
+#include <IS_DCMotor_ShadeControl.h> //Implements DC Motor shade controller
+#include <ShadeGroup.h>  //Moves several shades as one, staggering the motor starts
+#include <ShadeLog.h>  //Shade log ring buffer
+#include <ShadeMetrics.h>  //Loop and shade timing for /metrics
+#include <ShadeStore.h>
+#include <DeadlineScheduler.h>  //Move timeouts, for the loop() below
+#include <ShadeLocalControl.h>  //Direct shade control over UDP from the LAN
+#include <PS_Illuminance.h> //Illuminance
+#include <IS_Motion.h>  //Motion
+//*************************************************************************************************
+//NodeMCU v1.0 ESP8266-12e Pin Definitions (makes it much easier as these match the board markings)
+//                    -Do NOT uncomment these statements as they are defined by the board manager
+//*************************************************************************************************
+#define LED_BUILTIN 16
+#define BUILTIN_LED 16
+
+#define D0 16  //no internal pullup resistor
+#define D1  5
+#define D2  4
+#define D3  0  //must not be pulled low during power on/reset, toggles value during boot
+#define D4  2  //must not be pulled low during power on/reset, toggles value during boot
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15  //must not be pulled high during power on/reset
+
+//******************************************************************************************
+//Define which Arduino Pins will be used for each device
+//******************************************************************************************
+#define PIN_ILLUMINANCE   A0
+#define PIN_OPEN_SWITCH   D1
+#define PIN_CLOSE_SWITCH  0     // not using close switch  D2
+#define PIN_MOTION        D4    //was D3
+#define PIN_MOTOR_ENABLE  D5
+#define PIN_MOTOR_OPEN    D7
+#define PIN_MOTOR_CLOSE   D6
+//******************************************************************************************
+//ESP8266 WiFi Information
+//******************************************************************************************
+String str_ssid     = "xxxxxxxxxx";                           //  <---You must edit this line!
+String str_password = "xxxxxxxxxx";                   //  <---You must edit this line!
+IPAddress ip(192, 168, 1, 143);       //Device IP Address       //  <---You must edit this line!
+IPAddress gateway(192, 168, 1, 1);    //Router gateway          //  <---You must edit this line!
+IPAddress dnsserver(192, 168, 1, 1);  //DNS server              //  <---You must edit this line!
+IPAddress subnet(255, 255, 255, 0);   //LAN subnet mask         //  <---You must edit this line!
+const unsigned int serverPort = 8090; // port to run the http server on
+const unsigned int localControlPort = 8091;  // UDP port for direct shade control, see ShadeLocalControl.h
+
+// Hubitat Hub Information
+IPAddress hubIp(192, 168, 1, 118);    // hubitat hub ip         //  <---You must edit this line!
+const unsigned int hubPort = 39501;   // hubitat hub port
+
+//******************************************************************************************
+//st::Everything::callOnMsgSend() optional callback routine.  This is a sniffer to monitor 
+//    data being sent to ST.  This allows a user to act on data changes locally within the 
+//    Arduino sktech.
+//******************************************************************************************
+void callback(const String &msg)
+{
+}
+
+//******************************************************************************************
+//Declare each Device that is attached to the Arduino
+//  Notes: - For documentation on each device's constructor arguments below, please refer to  
+//           the corresponding header (.h) and program (.cpp) files.
+//         - Declared globally so the shade constructors turn the motor outputs off before setup() runs
+//         - The new Composite Device Handler is comprised of a Parent DH and various Child
+//           DH's.  The names used below MUST not be changed for the Automatic Creation of
+//           child devices to work properly.  Simply increment the number by +1 for each duplicate
+//           device (e.g. valve1, valve2, valve3, etc...)  You can rename the Child Devices
+//           to match your specific use case in the Hubitat IDE  
+//******************************************************************************************
+ //       st::IS_DCMotor_ShadeControl() constructor requires the following arguments
+//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
+//        - byte pinOpenSW - REQUIRED - the Arduino Pin to be used as a digital input for open switch   (if not used set to 0, then shade will stop after openTimeLimit and be open)
+//        - long openTimeLimit - REQUIRED - the number of seconds to run shade to open if no switch encountered
+//        - byte pinClosedSW - REQUIRED - the Arduino Pin to be used as a digital input for closed switch  (if not used set to 0, then shade will stop after closeTimeLimit and be closed)
+//        - long closedTimeLimit - REQUIRED - the number of seconds to run shade to close if no switch encountered
+//        - bool interruptActiveState - REQUIRED - LOW or HIGH - determines which value indicates the interrupt is true for both inputs
+//        - bool internalPullup - REQUIRED - true == INTERNAL_PULLUP for both inputs
+//        - byte pinOutputOpen - REQUIRED - the Arduino Pin to be used as a digital output for open
+//        - byte pinOutputClose - REQUIRED - the Arduino Pin to be used as a digital output for close
+//        - byte pinMotorEnablePWM - REQUIRED - the Arduino Pin to be used as a digital PWM output -simulate analog
+//        - long PWMSpeedValue to output on PWM enable output
+//        - state desiredStartState - REQUIRED - (open or closed) -pick the one that has a real switch
+//        - bool invertOutputLogic - REQUIRED - determines whether the Arduino Digital Outputs should use inverted logic
+
+
+
+st::IS_DCMotor_ShadeControl sensor1(F("windowDCShade1"), PIN_OPEN_SWITCH,60,PIN_CLOSE_SWITCH,48, LOW, true, PIN_MOTOR_OPEN,PIN_MOTOR_CLOSE, PIN_MOTOR_ENABLE, 1000, open, false);
+
+//  More shades can share this board (e.g. the L298N's second channel) - each keeps its own timeouts, found by name
+//st::IS_DCMotor_ShadeControl sensor4(F("windowDCShade2"), PIN_OPEN_SWITCH2,60,0,48, LOW, true, PIN_MOTOR_OPEN2,PIN_MOTOR_CLOSE2, PIN_MOTOR_ENABLE2, 1000, open, false);
+
+//        st::ShadeGroup() - several shades as one hub device, started one at a time so the inrush can't brown out the board
+//        - String &name - REQUIRED - a windowDCShade name, the hub treats the group as one more shade
+//        - byte maxRunning - REQUIRED - motors allowed to run at once on this board
+//        - unsigned int staggerMillis - REQUIRED - least time between two motor starts
+//st::ShadeGroup group1(F("windowDCShade9"), 1, 400);
+
+//        st::PS_Illuminance() constructor requires the following arguments
+//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
+//        - long interval - REQUIRED - the polling interval in seconds
+//        - long offset - REQUIRED - the polling interval offset in seconds - used to prevent all polling sensors from executing at the same time
+//        - byte pin - REQUIRED - the Arduino Pin to be used as a digital output
+//        - int s_l - OPTIONAL - first argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
+//        - int s_h - OPTIONAL - second argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
+//        - int m_l - OPTIONAL - third argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
+//        - int m_h - OPTIONAL - fourth argument of Arduino map(s_l,s_h,m_l,m_h) function to scale the output
+ 
+st::PS_Illuminance sensor2(F("illuminance1"), 900, 0, PIN_ILLUMINANCE, 0, 1023, 100,0);
+
+//        st::IS_Motion() constructor requires the following arguments
+//        - String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
+//        - byte pin - REQUIRED - the Arduino Pin to be used as a digital output
+//        - bool iState - OPTIONAL - LOW or HIGH - determines which value indicates the interrupt is true
+//        - bool internalPullup - OPTIONAL - true == INTERNAL_PULLUP
+//        - long numReqCounts - OPTIONAL - number of counts before changing state of input (prevent false alarms)
+//        - long inactiveTimeout - OPTIONAL - number of milliseconds motion must be inactive before sending update 
+
+st::IS_Motion sensor3(F("motion1"), PIN_MOTION, HIGH, false, 1,500);
+
+
+//******************************************************************************************
+//Boot sequence - setup() only makes the shades safe, loop() brings the network up a step at a time
+//  BootWifi     - wait for the WiFi connection without blocking, WiFi.begin() again every WIFI_RETRY_MILLIS
+//  BootServices - mDNS, OTA and the web server
+//  BootHub      - the hub connection, then every device is added and initialised
+//  BootOnline   - normal running
+//******************************************************************************************
+enum bootStage {BootWifi=0, BootServices=1, BootHub=2, BootOnline=3};
+const unsigned long WIFI_RETRY_MILLIS = 15000;
+bootStage boot = BootWifi;
+unsigned long wifiBeginMillis = 0;
+unsigned long bootSafeMicros = 0;         //reset to motor outputs off and limit switches read
+unsigned long bootHubOnlineMillis = 0;    //reset to the hub connection up and the devices initialised, 0 until then
+
+//******************************************************************************************
+//loop() - a web page can hold it for a while, so the web server and mDNS wait out the last NETWORK_GUARD_MILLIS
+//before a shade's move timeout and the pass goes straight back to the shades once one is due
+//******************************************************************************************
+const unsigned long NETWORK_GUARD_MILLIS = 200;
+unsigned long networkDeferredPasses = 0;
+byte deadlinesArmedMax = 0;               //most moves timed at once
+
+//******************************************************************************************
+//Web server /log page - the shade log ring buffer, oldest line first
+//******************************************************************************************
+void handleLog()
+{
+  httpServer.setContentLength(st::ShadeLog::length());
+  httpServer.send(200, "text/plain", "");
+  WiFiClient client = httpServer.client();
+  st::ShadeLog::printTo(client);
+}
+
+//******************************************************************************************
+//Web server /metrics page - CPU cycles per loop() stage, heap and every shade's counters, Prometheus text format
+//******************************************************************************************
+enum loopStage {StageRun=0, StageHttp=1, StageMdns=2, StageLog=3, StageLocal=4, LOOP_STAGES=5};
+static const char STAGE_RUN[] PROGMEM = "everything_run";
+static const char STAGE_HTTP[] PROGMEM = "http_handle_client";
+static const char STAGE_MDNS[] PROGMEM = "mdns_update";
+static const char STAGE_LOG[] PROGMEM = "shade_log";
+static const char STAGE_LOCAL[] PROGMEM = "local_control";
+static const char* const STAGE_NAME[LOOP_STAGES] PROGMEM = {STAGE_RUN, STAGE_HTTP, STAGE_MDNS, STAGE_LOG, STAGE_LOCAL};
+st::ShadeHistogram loopStageCycles[LOOP_STAGES];
+
+void printMetrics(Print &out, const st::ShadeHeap &heap)
+{
+  char stage[24];
+  for (byte i = 0; i < LOOP_STAGES; i++) {
+    strncpy_P(stage, (PGM_P)pgm_read_ptr(&STAGE_NAME[i]), sizeof(stage) - 1);
+    stage[sizeof(stage) - 1] = '\0';
+    st::ShadeMetrics::printHistogram(out, PSTR("loop_stage_cycles"), PSTR("stage"), stage, loopStageCycles[i]);
+  }
+  st::ShadeMetrics::printHeap(out, heap);
+  st::ShadeMetrics::printValue(out, PSTR("store_commits"), NULL, NULL, st::ShadeStore::getStats().commits);
+  st::ShadeMetrics::printValue(out, PSTR("log_dropped_bytes"), NULL, NULL, st::ShadeLog::droppedBytes());
+  st::ShadeMetrics::printValue(out, PSTR("boot_safe_micros"), NULL, NULL, bootSafeMicros);
+  st::ShadeMetrics::printValue(out, PSTR("boot_hub_online_millis"), NULL, NULL, bootHubOnlineMillis);
+  st::ShadeMetrics::printValue(out, PSTR("network_deferred_passes"), NULL, NULL, networkDeferredPasses);
+  st::ShadeMetrics::printValue(out, PSTR("deadlines_armed_max"), NULL, NULL, deadlinesArmedMax);
+  st::ShadeLocalControl::printMetrics(out);
+  for (byte i = 0; i < st::IS_DCMotor_ShadeControl::getShadeCount(); i++) {
+    st::IS_DCMotor_ShadeControl::getShade(i)->printMetrics(out);
+  }
+}
+
+void handleMetrics()
+{
+  //measured first, then written straight to the client - the page is never held in RAM.  The heap moves under
+  //send(), so both passes print the figures read here
+  st::ShadeHeap heap = st::ShadeMetrics::readHeap();
+  st::CountingPrint length;
+  printMetrics(length, heap);
+  httpServer.setContentLength(length.count());
+  httpServer.send(200, "text/plain", "");
+  WiFiClient client = httpServer.client();
+  printMetrics(client, heap);
+}
+
+//******************************************************************************************
+//HTTP update progress - the update server restarts the board as soon as the upload ends, so whatever ShadeStore
+//still holds in RAM is committed with every chunk
+//******************************************************************************************
+void updateProgress(size_t done, size_t total)
+{
+  (void)done;
+  (void)total;
+  st::ShadeStore::flush();
+}
+
+//******************************************************************************************
+//bootStep() - one step of the boot sequence per loop() pass, none of them waits on the network
+//******************************************************************************************
+void bootStep()
+{
+  switch (boot) {
+    case BootWifi:
+      if (WiFi.status() != WL_CONNECTED) {
+        if (millis() - wifiBeginMillis >= WIFI_RETRY_MILLIS) {
+          SHADE_LOG_INFO("WiFi failed, retrying.");
+          WiFi.begin(str_ssid, str_password);
+          wifiBeginMillis = millis();
+        }
+        return;
+      }
+      SHADE_LOG_INFO("WiFi connected after %lu ms", millis());
+      boot = BootServices;
+      break;
+
+    case BootServices:
+      MDNS.begin(host);
+      httpUpdater.setup(&httpServer);
+      Update.onProgress(updateProgress);
+      httpServer.on("/log", handleLog);
+      httpServer.on("/metrics", handleMetrics);
+      httpServer.begin();
+      MDNS.addService("http", "tcp", 80);
+      SHADE_LOG_INFO("HTTPUpdateServer ready! Open http://%s.local/update in your browser", host);
+      boot = BootHub;
+      break;
+
+    case BootHub:
+      //*****************************************************************************
+      //  Configure debug print output from each main class 
+      //  -Note: Set these to "false" if using Hardware Serial on pins 0 & 1
+      //         to prevent communication conflicts with the ST Shield communications
+      //*****************************************************************************
+      st::Everything::debug=true;
+      st::Executor::debug=true;
+      st::Device::debug=true;
+      st::Sensor::debug=true;
+      st::PollingSensor::debug=true;
+      st::InterruptSensor::debug=true;
+
+      //*****************************************************************************
+      //Initialize the "Everything" Class
+      //*****************************************************************************
+
+      //Initialize the optional local callback routine (safe to comment out if not desired)
+      st::Everything::callOnMsgSend = callback;
+
+      //Create the SmartThings ESP8266WiFi Communications Object
+        //Pre-existing connection - WiFi (with its static IP) is already up, so init() below doesn't wait for it
+        st::Everything::SmartThing = new st::SmartThingsESP8266WiFi(serverPort, hubIp, hubPort, st::receiveSmartString);
+
+      //Run the Everything class' init() routine which establishes communications with Hubitat Hub
+      st::Everything::init();
+
+      //*****************************************************************************
+      //Add each sensor to the "Everything" Class
+      //*****************************************************************************
+      st::Everything::addSensor(&sensor1);
+      st::Everything::addSensor(&sensor2);
+      st::Everything::addSensor(&sensor3);
+      //st::Everything::addSensor(&sensor4);
+      //st::Everything::addSensor(&group1);     //after its shades, so they are updated first
+
+      //*****************************************************************************
+      //Initialize each of the devices which were added to the Everything Class
+      //*****************************************************************************
+      st::Everything::initDevices();
+
+      //direct control only once every shade has run init() - optional, comment out to turn it off
+      st::ShadeLocalControl::begin(localControlPort);
+
+      bootHubOnlineMillis = millis();
+      SHADE_LOG_INFO("Hub online after %lu ms, safe after %lu us", bootHubOnlineMillis, bootSafeMicros);
+      boot = BootOnline;
+      break;
+
+    case BootOnline:
+      break;
+  }
+}
+
+//******************************************************************************************
+//Arduino Setup() routine
+//******************************************************************************************
+void setup() 
+{
+  //******************************************************************************************
+  //Shades first - the constructors already turned the motor outputs off, read the limit switches
+  //before anything that can wait on the network
+  //******************************************************************************************
+//        IS_DCMotor_ShadeControl::setRamp() optional soft start/soft stop
+//        - rampProfile accelProfile - RAMP_NONE, RAMP_LINEAR or RAMP_SCURVE
+//        - unsigned int accelMillis - time from stopped to full speed (0 = off)
+//        - rampProfile decelProfile - RAMP_NONE, RAMP_LINEAR or RAMP_SCURVE
+//        - unsigned int decelMillis - time from full speed to stopped (0 = off)
+//        - byte creepPercent - percent of full speed to run into the limit switch at
+
+  sensor1.setRamp(RAMP_SCURVE, 800, RAMP_SCURVE, 1500, 40);
+
+//        IS_DCMotor_ShadeControl::enableSwitchInterrupts() optional - limit switches stop the motor from an interrupt
+//        - unsigned long debounceMicros - time the switch is left to settle before it is believed
+
+  sensor1.enableSwitchInterrupts(5000);
+
+//        IS_DCMotor_ShadeControl::enableBatchedFrames() optional - state and attributes go to the hub as one message
+//        - needs the HubDuino Parent Ethernet driver from this repository
+
+  sensor1.enableBatchedFrames();
+
+//        IS_DCMotor_ShadeControl::setDeadTime() optional - motor off time before a new direction (default 250)
+//        - unsigned int deadMillis - least time between the motor stopping and the next start
+
+  sensor1.setDeadTime(300);
+
+//        IS_DCMotor_ShadeControl::enableCurrentSense() optional - stop on a motor stall, a stall at the end of travel is the end
+//        - byte pinCurrent - analog input from the motor current sensor (the ESP8266 has only A0, used here for illuminance)
+//        - unsigned int stallLevel - analogRead() average that means stalled
+//        - unsigned int riseLevel - rise of the average over the last few samples that means it is being stopped (0 = off)
+//        - unsigned int blankMillis - time after a start the inrush is ignored
+
+  //sensor1.enableCurrentSense(PIN_MOTOR_CURRENT, 600, 150, 300);
+
+  //group1.add(sensor1);
+  //group1.add(sensor4);
+
+  for (byte i = 0; i < st::IS_DCMotor_ShadeControl::getShadeCount(); i++) {
+    st::IS_DCMotor_ShadeControl::getShade(i)->safeStart();
+  }
+  bootSafeMicros = micros();
+
+//******************************************************************************************
+// O T A  Stuff - only started here, loop() waits for the connection
+//******************************************************************************************
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("Setting up OTA..");
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.config(ip, gateway, subnet, dnsserver);
+  WiFi.begin(str_ssid, str_password);
+  wifiBeginMillis = millis();
+}
+
+//******************************************************************************************
+//Arduino Loop() routine
+//******************************************************************************************
+void loop()
+{
+  //*****************************************************************************
+  //  Booting - the limit switches are watched while the network comes up
+  //*****************************************************************************
+  if (boot != BootOnline) {
+    for (byte i = 0; i < st::IS_DCMotor_ShadeControl::getShadeCount(); i++) {
+      st::IS_DCMotor_ShadeControl::getShade(i)->update();
+    }
+    bootStep();
+    if (boot >= BootHub) {
+      httpServer.handleClient();
+      MDNS.update();
+    }
+    st::ShadeLog::service();
+    return;
+  }
+
+  //*****************************************************************************
+  //Execute the Everything run method which takes care of "Everything"
+  //*****************************************************************************
+  uint32_t cycles = st::ShadeMetrics::cycles();
+  uint32_t now;
+  st::Everything::run();
+  now = st::ShadeMetrics::cycles();
+  loopStageCycles[StageRun].add(now - cycles);
+  cycles = now;
+
+  byte armed = st::DeadlineScheduler::armedCount();
+  if (armed > deadlinesArmedMax) deadlinesArmedMax = armed;
+
+  //a move timeout came due while run() went round the other devices - back to the shades at once
+  if (st::DeadlineScheduler::anyDue()) return;
+
+  //*****************************************************************************
+  //  O T A - not this close to a move timeout
+  //*****************************************************************************
+  if (st::DeadlineScheduler::millisUntilNext() > NETWORK_GUARD_MILLIS) {
+    httpServer.handleClient();
+    now = st::ShadeMetrics::cycles();
+    loopStageCycles[StageHttp].add(now - cycles);
+    cycles = now;
+
+    MDNS.update();
+    now = st::ShadeMetrics::cycles();
+    loopStageCycles[StageMdns].add(now - cycles);
+    cycles = now;
+  } else {
+    networkDeferredPasses++;
+  }
+
+  //*****************************************************************************
+  //  Direct UDP shade control - the hub hears about it through the shades' usual messages
+  //*****************************************************************************
+  st::ShadeLocalControl::service();
+  now = st::ShadeMetrics::cycles();
+  loopStageCycles[StageLocal].add(now - cycles);
+  cycles = now;
+
+  //*****************************************************************************
+  //  Shade log - send what Serial can take without waiting
+  //*****************************************************************************
+  st::ShadeLog::service();
+  loopStageCycles[StageLog].add(st::ShadeMetrics::cycles() - cycles);
+}
@@ -0,0 +1,233 @@
+//******************************************************************************************
+//  File: ShadeGroup.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeGroup.h"
+
+#include "Everything.h"
+#include "ShadeLog.h"
+
+namespace st
+{
+//private
+//runningMotors - shades on the board with their motor on
+	byte ShadeGroup::runningMotors()
+	{
+		byte running = 0;
+		for (byte i = 0; i < IS_DCMotor_ShadeControl::getShadeCount(); i++) {
+			IS_DCMotor_ShadeControl *shade = IS_DCMotor_ShadeControl::getShade(i);
+			state s = shade->getState();
+			//a waiting command is a start already promised - it may be sitting out the dead time
+			if ((s == opening) || (s == closing) || shade->isCommandQueued()) running++;
+		}
+		return running;
+	}
+
+//anyMemberMoving
+	bool ShadeGroup::anyMemberMoving() const
+	{
+		for (byte i = 0; i < m_nMembers; i++) {
+			state s = m_pMembers[i]->getState();
+			if ((s == opening) || (s == closing) || m_pMembers[i]->isCommandQueued()) return true;
+		}
+		return false;
+	}
+
+//groupState - open or closed when every member agrees, otherwise partially open
+	state ShadeGroup::groupState() const
+	{
+		byte opened = 0;
+		byte closedCount = 0;
+		for (byte i = 0; i < m_nMembers; i++) {
+			state s = m_pMembers[i]->getState();
+			if (s == open) opened++;
+			else if (s == closed) closedCount++;
+		}
+		if ((m_nMembers > 0) && (opened == m_nMembers)) return open;
+		if ((m_nMembers > 0) && (closedCount == m_nMembers)) return closed;
+		return partial;
+	}
+
+//sendState - "<name> <state>"
+	void ShadeGroup::sendState(state s)
+	{
+		sendText(NULL, IS_DCMotor_ShadeControl::stateName(s));
+	}
+
+//sendAck - "<name> ack:<verb>"
+	void ShadeGroup::sendAck(PGM_P verb)
+	{
+		sendText(PSTR("ack:"), verb);
+	}
+
+//sendText - "<name> <lead><text>", both in flash
+	void ShadeGroup::sendText(PGM_P lead, PGM_P text)
+	{
+		char buf[MSG_BUFFER_SIZE];
+		size_t len = getName().length();
+		if (len > sizeof(buf) - 24) len = sizeof(buf) - 24;
+		memcpy(buf, getName().c_str(), len);
+		buf[len++] = ' ';
+		if (lead != NULL) {
+			strncpy_P(buf + len, lead, sizeof(buf) - len - 1);
+			buf[sizeof(buf) - 1] = '\0';
+			len = strlen(buf);
+		}
+		strncpy_P(buf + len, text, sizeof(buf) - len - 1);
+		buf[sizeof(buf) - 1] = '\0';
+		m_sMsg = buf;
+		if (Everything::SmartThing != NULL) Everything::sendSmartStringNow(m_sMsg);
+	}
+
+//public
+//constructor
+	ShadeGroup::ShadeGroup(const __FlashStringHelper *name, byte maxRunning, unsigned int staggerMillis):
+		Sensor(name),
+		m_nMembers(0),
+		m_nMaxRunning(maxRunning > 0 ? maxRunning : 1),
+		m_nStaggerMillis(staggerMillis),
+		m_bActive(false),
+		m_lLastStartMillis(0)
+	{
+		m_szCommand[0] = '\0';
+		m_sMsg.reserve(MSG_BUFFER_SIZE);
+	}
+
+//destructor
+	ShadeGroup::~ShadeGroup()
+	{
+	}
+
+//add
+	bool ShadeGroup::add(IS_DCMotor_ShadeControl &shade)
+	{
+		if (m_nMembers >= MAX_MEMBERS) {
+			SHADE_LOG_ERROR("ShadeGroup::add - group full, increase MAX_MEMBERS");
+			return false;
+		}
+		m_bPending[m_nMembers] = false;
+		m_pMembers[m_nMembers++] = &shade;
+		return true;
+	}
+
+//init
+	void ShadeGroup::init()
+	{
+		refresh();
+	}
+
+//update
+	void ShadeGroup::update()
+	{
+		if (!m_bActive) return;
+
+		//start as many members as the budget allows - one per stagger interval
+		for (byte i = 0; i < m_nMembers; i++) {
+			if (!m_bPending[i]) continue;
+			if (runningMotors() >= m_nMaxRunning) break;
+			if ((uint32_t)(millis() - m_lLastStartMillis) < m_nStaggerMillis) break;
+
+			m_bPending[i] = false;
+			m_pMembers[i]->runCommand(m_szCommand);
+
+			//only a motor that started, or will once its dead time is up, uses up the stagger time
+			state s = m_pMembers[i]->getState();
+			if ((s == opening) || (s == closing) || m_pMembers[i]->isCommandQueued()) {
+				m_lLastStartMillis = millis();
+				SHADE_LOG_DEBUG("ShadeGroup::update - started %s", m_pMembers[i]->getName().c_str());
+			}
+		}
+
+		for (byte i = 0; i < m_nMembers; i++) {
+			if (m_bPending[i]) return;
+		}
+		if (anyMemberMoving()) return;
+
+		//everything queued has run and stopped - one completion event
+		m_bActive = false;
+		state s = groupState();
+		sendState(s);
+		SHADE_LOG_INFO("%s %s", getName().c_str(), IS_DCMotor_ShadeControl::stateName(s));
+	}
+
+//beSmart
+	void ShadeGroup::beSmart(const String &str)
+	{
+		const char *verb = str.c_str();
+		const char *space = strchr(verb, ' ');
+		if (space != NULL) verb = space + 1;
+		size_t verbLen = strcspn(verb, ": \r\n");
+
+		//stop - drop what hasn't started and stop what has
+		if ((verbLen == 4) && (strncmp_P(verb, PSTR("stop"), 4) == 0)) {
+			if (!m_bActive && !anyMemberMoving()) {
+				sendState(groupState());
+				return;
+			}
+			sendAck(PSTR("stop"));
+			for (byte i = 0; i < m_nMembers; i++) {
+				m_bPending[i] = false;
+				state s = m_pMembers[i]->getState();
+				if ((s == opening) || (s == closing) || m_pMembers[i]->isCommandQueued()) m_pMembers[i]->runCommand(verb);
+			}
+			return;
+		}
+
+		state moving;
+		PGM_P ack;
+		if ((verbLen == 4) && (strncmp_P(verb, PSTR("open"), 4) == 0)) {
+			ack = PSTR("open");
+			moving = opening;
+		} else if ((verbLen == 5) && (strncmp_P(verb, PSTR("close"), 5) == 0)) {
+			ack = PSTR("close");
+			moving = closing;
+		} else if ((verbLen == 8) && (strncmp_P(verb, PSTR("position:"), 9) == 0)) {
+			//direction of the group as a whole, from the average member position
+			unsigned int total = 0;
+			for (byte i = 0; i < m_nMembers; i++) total += m_pMembers[i]->getPosition();
+			//already there on average - the members report their own state and the completion event follows
+			unsigned long target = strtoul(verb + 9, NULL, 10) * m_nMembers;
+			moving = (target < total) ? closing : (target > total) ? opening : groupState();
+			ack = PSTR("position");
+		} else {
+			SHADE_LOG_ERROR("ShadeGroup::beSmart - unknown command: %s", verb);
+			return;
+		}
+
+		//a command no member would act on is not acknowledged - it still replaces one being handed out, members
+		//with one waiting drop it and report their state, and the group reports its own
+		bool anyRuns = false;
+		for (byte i = 0; i < m_nMembers; i++) anyRuns |= m_pMembers[i]->wouldRun(verb);
+		if (!anyRuns) {
+			for (byte i = 0; i < m_nMembers; i++) {
+				m_bPending[i] = false;
+				if (m_pMembers[i]->isCommandQueued()) m_pMembers[i]->runCommand(verb);
+			}
+			m_bActive = false;
+			sendState(groupState());
+			return;
+		}
+		sendAck(ack);
+
+		//a new command replaces one still being handed out
+		strncpy(m_szCommand, verb, sizeof(m_szCommand) - 1);
+		m_szCommand[sizeof(m_szCommand) - 1] = '\0';
+		m_szCommand[strcspn(m_szCommand, " \r\n")] = '\0';
+		for (byte i = 0; i < m_nMembers; i++) m_bPending[i] = true;
+		m_bActive = true;
+		m_lLastStartMillis = millis() - m_nStaggerMillis;   //first start at once
+
+		if ((moving == opening) || (moving == closing)) sendState(moving);
+		update();
+	}
+
+//refresh
+	void ShadeGroup::refresh()
+	{
+		if (m_bActive) return;      //the completion event follows
+		sendState(groupState());
+	}
+}
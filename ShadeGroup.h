@@ -0,0 +1,88 @@
+//******************************************************************************************
+//  File: ShadeGroup.h
+//
+//  Summary:  ShadeGroup moves several IS_DCMotor_ShadeControl shades as one, without starting every motor at the same
+//			  instant.  Starting motors draw several times their running current for a moment, and a "close all" that
+//			  starts them together can brown out the board.
+//
+//			  To the hub the group is one more shade - give it a windowDCShade name and it gets a Child Window DC Shade
+//			  device.  open, close, stop and position:nn are queued for every member, and update() starts them one at a
+//			  time - only while fewer than maxRunning motors are running on the whole board (group members or not), and
+//			  at least staggerMillis after the previous start.  A member that is already where it was sent doesn't use a
+//			  start slot.  The group reports "opening"/"closing" when the command arrives and one final state (open,
+//			  closed or partially_open) once every member has stopped.  A shade with a command still waiting in its
+//			  command slot counts as running.  Each command taken is acknowledged with "<name> ack:<verb>" - one that no
+//			  member would act on (close with every member closed, stop with nothing moving) is not, the group
+//			  reports its state instead.
+//
+//			  Create an instance of this class in your sketch and add() the shades to it
+//			  For Example:  st::ShadeGroup group1(F("windowDCShade9"), 1, 400);
+//							group1.add(sensor1);
+//							group1.add(sensor4);
+//
+//			  st::ShadeGroup() constructor requires the following arguments
+//				- String &name - REQUIRED - the name of the object - must match the Groovy ST_Anything DeviceType tile name
+//				- byte maxRunning - REQUIRED - motors allowed to run at once on this board
+//				- unsigned int staggerMillis - REQUIRED - least time between two motor starts
+//
+//******************************************************************************************
+
+#ifndef ST_SHADEGROUP_H
+#define ST_SHADEGROUP_H
+
+#include "Sensor.h"
+#include "IS_DCMotor_ShadeControl.h"
+
+namespace st
+{
+	class ShadeGroup:public Sensor
+	{
+		private:
+			static const byte MAX_MEMBERS = 8;
+			static const byte COMMAND_SIZE = 16;        //"position:100" and the terminator
+			static const byte MSG_BUFFER_SIZE = 48;
+
+			IS_DCMotor_ShadeControl* m_pMembers[MAX_MEMBERS];
+			byte m_nMembers;
+			bool m_bPending[MAX_MEMBERS];               //still to be started for the current command
+			byte m_nMaxRunning;
+			unsigned int m_nStaggerMillis;
+			char m_szCommand[COMMAND_SIZE];             //command being handed out
+			bool m_bActive;                             //command in progress - completion not reported yet
+			unsigned long m_lLastStartMillis;
+			String m_sMsg;                              //reserved once, reused for every message
+
+			static byte runningMotors();                //every shade on the board, not just members
+			bool anyMemberMoving() const;
+			state groupState() const;
+			void sendState(state s);
+			void sendAck(PGM_P verb);
+			void sendText(PGM_P lead, PGM_P text);
+
+		public:
+			//constructor - called in your sketch's global variable declaration section
+			ShadeGroup(const __FlashStringHelper *name, byte maxRunning, unsigned int staggerMillis);
+
+			//destructor
+			virtual ~ShadeGroup();
+
+			//initialization function
+			virtual void init();
+
+			//starts queued moves under the motor budget, reports completion
+			virtual void update();
+
+			//SmartThings Shield data handler - open, close, stop, position:nn for every member
+			virtual void beSmart(const String &str);
+
+			//called periodically by Everything class to ensure ST Cloud is kept consistent with the state of the group
+			virtual void refresh();
+
+			//adds a shade - false when the group is full
+			bool add(IS_DCMotor_ShadeControl &shade);
+
+			bool isActive() const { return m_bActive; }
+	};
+}
+
+#endif
@@ -0,0 +1,147 @@
+//******************************************************************************************
+//  File: ShadeLocalControl.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeLocalControl.h"
+
+#include "IS_DCMotor_ShadeControl.h"
+#include "ShadeMetrics.h"
+#include "ShadeLog.h"
+
+#if defined(ESP8266) || defined(ESP32)
+#include <WiFiUdp.h>
+#endif
+
+//runCommand() verbs, indexed by localOp
+static const char LOCAL_OPEN[] PROGMEM = "open";
+static const char LOCAL_CLOSE[] PROGMEM = "close";
+static const char LOCAL_STOP[] PROGMEM = "stop";
+static const char LOCAL_POSITION[] PROGMEM = "position:";
+static const char* const LOCAL_VERB[] PROGMEM = {NULL, LOCAL_OPEN, LOCAL_CLOSE, LOCAL_STOP, LOCAL_POSITION};
+
+static const char METRIC_LOCAL_REQUESTS[] PROGMEM = "local_control_requests";
+static const char METRIC_LOCAL_REJECTS[] PROGMEM = "local_control_rejects";
+static const char METRIC_LOCAL_DROPPED[] PROGMEM = "local_control_dropped";
+static const char METRIC_LOCAL_BUSY[] PROGMEM = "local_control_busy_passes";
+
+#if defined(ESP8266) || defined(ESP32)
+static WiFiUDP s_Udp;
+#endif
+
+namespace st
+{
+	bool ShadeLocalControl::s_bOpen = false;
+	ShadeLocalStats ShadeLocalControl::s_Stats;
+	byte ShadeLocalControl::s_Request[ShadeLocalControl::REQUEST_SIZE];
+	byte ShadeLocalControl::s_Response[ShadeLocalControl::RESPONSE_SIZE];
+
+//private
+//handle - one request in s_Request, length bytes long
+	byte ShadeLocalControl::handle(byte length)
+	{
+		byte op = s_Request[3];
+		byte index = s_Request[4];
+
+		memset(s_Response, 0, sizeof(s_Response));
+		s_Response[0] = 'S';
+		s_Response[1] = 'R';
+		s_Response[2] = PROTOCOL_VERSION;
+		s_Response[3] = op;
+		s_Response[4] = index;
+		s_Response[6] = s_Request[6];
+		s_Response[7] = s_Request[7];
+		s_Response[11] = IS_DCMotor_ShadeControl::getShadeCount();
+
+		if ((length != REQUEST_SIZE) || (s_Request[2] != PROTOCOL_VERSION)) return ResultBadRequest;
+
+		IS_DCMotor_ShadeControl *shade = IS_DCMotor_ShadeControl::getShade(index);
+		if (shade == NULL) return ResultNoShade;
+
+		if ((op >= OpOpen) && (op <= OpPosition)) {
+			//"position:" plus up to 3 digits - the same text the hub would send
+			char verb[16];
+			strncpy_P(verb, (PGM_P)pgm_read_ptr(&LOCAL_VERB[op]), sizeof(verb) - 1);
+			verb[sizeof(verb) - 1] = '\0';
+			if (op == OpPosition) {
+				if (s_Request[5] > 100) return ResultBadRequest;
+				utoa(s_Request[5], verb + strlen(verb), 10);
+			}
+			SHADE_LOG_DEBUG("ShadeLocalControl - %s %s", shade->getName().c_str(), verb);
+			shade->runCommand(verb);
+		} else if (op != OpStatus) {
+			return ResultBadOp;
+		}
+
+		s_Response[8] = shade->getState();
+		s_Response[9] = shade->getPosition();
+		s_Response[10] = (shade->isPositionKnown() ? FLAG_POSITION_KNOWN : 0) | (shade->isCommandQueued() ? FLAG_COMMAND_QUEUED : 0);
+		return ResultOk;
+	}
+
+//public
+//begin
+	bool ShadeLocalControl::begin(uint16_t port)
+	{
+#if defined(ESP8266) || defined(ESP32)
+		memset(&s_Stats, 0, sizeof(s_Stats));
+		s_bOpen = s_Udp.begin(port);
+		if (s_bOpen) {
+			SHADE_LOG_INFO("ShadeLocalControl - listening on UDP port %u", port);
+		} else {
+			SHADE_LOG_ERROR("ShadeLocalControl::begin - could not open UDP port %u", port);
+		}
+#else
+		(void)port;
+		SHADE_LOG_ERROR("ShadeLocalControl::begin - no UDP on this board");
+#endif
+		return s_bOpen;
+	}
+
+//service
+	void ShadeLocalControl::service()
+	{
+#if defined(ESP8266) || defined(ESP32)
+		if (!s_bOpen) return;
+
+		for (byte n = 0; n < MAX_PER_SERVICE; n++) {
+			int size = s_Udp.parsePacket();
+			if (size <= 0) return;
+
+			memset(s_Request, 0, sizeof(s_Request));
+			int length = s_Udp.read(s_Request, sizeof(s_Request));
+
+			//not ours - no reply, so stray traffic can't be bounced off the board
+			if ((length < 4) || (s_Request[0] != 'S') || (s_Request[1] != 'C')) {
+				s_Stats.dropped++;
+				continue;
+			}
+
+			byte result = handle((size == REQUEST_SIZE) ? REQUEST_SIZE : 0);
+			s_Response[5] = result;
+			s_Stats.requests++;
+			if (result != ResultOk) s_Stats.rejects++;
+
+			if (!s_Udp.beginPacket(s_Udp.remoteIP(), s_Udp.remotePort()) ||
+				(s_Udp.write(s_Response, sizeof(s_Response)) != sizeof(s_Response)) ||
+				!s_Udp.endPacket()) {
+				s_Stats.dropped++;
+			}
+		}
+
+		//used up MAX_PER_SERVICE - anything more waits for the next loop()
+		s_Stats.busyPasses++;
+#endif
+	}
+
+//printMetrics
+	void ShadeLocalControl::printMetrics(Print &out)
+	{
+		ShadeMetrics::printValue(out, METRIC_LOCAL_REQUESTS, NULL, NULL, s_Stats.requests);
+		ShadeMetrics::printValue(out, METRIC_LOCAL_REJECTS, NULL, NULL, s_Stats.rejects);
+		ShadeMetrics::printValue(out, METRIC_LOCAL_DROPPED, NULL, NULL, s_Stats.dropped);
+		ShadeMetrics::printValue(out, METRIC_LOCAL_BUSY, NULL, NULL, s_Stats.busyPasses);
+	}
+}
@@ -0,0 +1,88 @@
+//******************************************************************************************
+//  File: ShadeLocalControl.h
+//
+//  Summary:  ShadeLocalControl is an optional UDP endpoint for driving the shades straight from the LAN, without the
+//			  round trip automation -> hub -> port 8090 and the status POST back.  Every request is one datagram of
+//			  REQUEST_SIZE bytes and gets one reply of RESPONSE_SIZE bytes, built in fixed static buffers, so a request
+//			  costs no heap.  service() answers at most MAX_PER_SERVICE requests per call to keep loop() short.
+//
+//			  Commands go through IS_DCMotor_ShadeControl::runCommand() exactly like the hub's, so they use the command
+//			  slot and dead time, and the hub still hears about them through the usual messages (ack:<verb>, the state
+//			  and the position).  Shades are addressed by their index in IS_DCMotor_ShadeControl::getShade(), i.e. the
+//			  order they are constructed in.  There is no authentication - only enable it on a network you trust.
+//
+//			  Request (8 bytes)
+//				0-1  'S' 'C'
+//				2    PROTOCOL_VERSION
+//				3    op - OpOpen, OpClose, OpStop, OpPosition or OpStatus
+//				4    shade index
+//				5    position 0-100 for OpPosition, otherwise 0
+//				6-7  sequence number, little endian - echoed in the reply
+//
+//			  Response (12 bytes)
+//				0-1  'S' 'R'
+//				2    PROTOCOL_VERSION
+//				3    op, as requested
+//				4    shade index, as requested
+//				5    result - ResultOk, ResultBadRequest, ResultNoShade or ResultBadOp
+//				6-7  sequence number, as requested
+//				8    state after the request (IS_DCMotor_ShadeControl enum state)
+//				9    position 0-100
+//				10   flags - FLAG_POSITION_KNOWN, FLAG_COMMAND_QUEUED
+//				11   number of shades on the board
+//
+//			  Call st::ShadeLocalControl::begin(port) once the devices are initialised and service() from loop().
+//
+//******************************************************************************************
+
+#ifndef ST_SHADELOCALCONTROL_H
+#define ST_SHADELOCALCONTROL_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	//counters since begin()
+	struct ShadeLocalStats
+	{
+		unsigned long requests;             //requests answered
+		unsigned long rejects;              //requests answered with an error result
+		unsigned long dropped;              //datagrams that were not requests, or replies that could not be sent
+		unsigned long busyPasses;           //service() calls that answered MAX_PER_SERVICE requests, more may be waiting
+	};
+
+	class ShadeLocalControl
+	{
+		public:
+			static const byte PROTOCOL_VERSION = 1;
+			static const byte REQUEST_SIZE = 8;
+			static const byte RESPONSE_SIZE = 12;
+			static const byte MAX_PER_SERVICE = 4;
+
+			enum localOp {OpOpen=1, OpClose=2, OpStop=3, OpPosition=4, OpStatus=5};
+			enum localResult {ResultOk=0, ResultBadRequest=1, ResultNoShade=2, ResultBadOp=3};
+			static const byte FLAG_POSITION_KNOWN = 0x01;
+			static const byte FLAG_COMMAND_QUEUED = 0x02;
+
+			//starts listening - false if the socket could not be opened
+			static bool begin(uint16_t port);
+
+			//answers waiting requests - call from the loop
+			static void service();
+
+			static const ShadeLocalStats& getStats() { return s_Stats; }
+
+			//writes the counters as local_control_* metrics - see ShadeMetrics
+			static void printMetrics(Print &out);
+
+		private:
+			static bool s_bOpen;
+			static ShadeLocalStats s_Stats;
+			static byte s_Request[REQUEST_SIZE];
+			static byte s_Response[RESPONSE_SIZE];
+
+			static byte handle(byte length);    //fills s_Response from s_Request - the result code
+	};
+}
+
+#endif
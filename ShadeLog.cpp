@@ -0,0 +1,92 @@
+//******************************************************************************************
+//  File: ShadeLog.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeLog.h"
+
+#include <stdarg.h>
+
+namespace st
+{
+	char ShadeLog::s_Buffer[ShadeLog::BUFFER_SIZE];
+	unsigned long ShadeLog::s_lWritten = 0;
+	unsigned long ShadeLog::s_lSerialSent = 0;
+	unsigned long ShadeLog::s_lDropped = 0;
+
+//private
+//oldest - first byte still in the ring
+	unsigned long ShadeLog::oldest()
+	{
+		return (s_lWritten > BUFFER_SIZE) ? s_lWritten - BUFFER_SIZE : 0;
+	}
+
+//public
+//write
+	void ShadeLog::write(PGM_P fmt, ...)
+	{
+		char line[LINE_SIZE];
+		int len = snprintf_P(line, sizeof(line), PSTR("%lu "), millis());
+
+		va_list args;
+		va_start(args, fmt);
+		vsnprintf_P(line + len, sizeof(line) - len - 1, fmt, args);
+		va_end(args);
+
+		len += strlen(line + len);
+		line[len++] = '\n';
+
+		for (int i = 0; i < len; i++) {
+			s_Buffer[s_lWritten % BUFFER_SIZE] = line[i];
+			s_lWritten++;
+		}
+
+		//Serial fell a whole ring behind - skip what was overwritten
+		if (s_lSerialSent < oldest()) {
+			s_lDropped += oldest() - s_lSerialSent;
+			s_lSerialSent = oldest();
+		}
+	}
+
+//service
+	void ShadeLog::service()
+	{
+		unsigned long pending = s_lWritten - s_lSerialSent;
+		if (pending == 0) return;
+
+		int room = Serial.availableForWrite();
+		if (room <= 0) return;
+
+		//one contiguous run per call, up to the end of the ring
+		unsigned int start = s_lSerialSent % BUFFER_SIZE;
+		unsigned long count = pending;
+		if (count > (unsigned long)room) count = room;
+		if (count > BUFFER_SIZE - start) count = BUFFER_SIZE - start;
+
+		Serial.write((const uint8_t *)(s_Buffer + start), count);
+		s_lSerialSent += count;
+	}
+
+//length
+	unsigned int ShadeLog::length()
+	{
+		return s_lWritten - oldest();
+	}
+
+//printTo
+	void ShadeLog::printTo(Print &out)
+	{
+		unsigned long from = oldest();
+		unsigned int start = from % BUFFER_SIZE;
+		unsigned int count = s_lWritten - from;
+
+		if (start + count > BUFFER_SIZE) {
+			out.write((const uint8_t *)(s_Buffer + start), BUFFER_SIZE - start);
+			out.write((const uint8_t *)s_Buffer, count - (BUFFER_SIZE - start));
+		} else {
+			out.write((const uint8_t *)(s_Buffer + start), count);
+		}
+	}
+}
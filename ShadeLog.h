@@ -0,0 +1,86 @@
+//******************************************************************************************
+//  File: ShadeLog.h
+//
+//  Summary:  ShadeLog keeps debug output off the motor control path.  Log lines are formatted into a fixed RAM ring
+//			  buffer and written to Serial later by service(), a few bytes at a time and only as many as the Serial
+//			  transmit buffer can take, so logging never waits on the UART.  When the ring is full the oldest lines are
+//			  dropped.  The ring can also be read back with printTo(), e.g. from a web server page.
+//
+//			  Levels are chosen at compile time - define SHADE_LOG_LEVEL before this header (or in the build flags) to
+//			  one of SHADE_LOG_LEVEL_NONE, _ERROR, _INFO or _DEBUG (default _INFO).  Log calls above that level
+//			  compile to nothing, arguments included.
+//
+//			  Usage (format strings stay in flash, printf style - the ESP8266 core's %s reads a PROGMEM string too, and
+//			  gcc checks the arguments against the format):
+//				SHADE_LOG_DEBUG("IS_DCMotor_ShadeControl::update - hit opened switch");
+//				SHADE_LOG_INFO("%s state %s", name, stateName);
+//
+//			  Call st::ShadeLog::service() from loop() after the rest of the work is done.
+//
+//******************************************************************************************
+
+#ifndef ST_SHADELOG_H
+#define ST_SHADELOG_H
+
+#include <Arduino.h>
+
+#define SHADE_LOG_LEVEL_NONE   0
+#define SHADE_LOG_LEVEL_ERROR  1
+#define SHADE_LOG_LEVEL_INFO   2
+#define SHADE_LOG_LEVEL_DEBUG  3
+
+#ifndef SHADE_LOG_LEVEL
+#define SHADE_LOG_LEVEL  SHADE_LOG_LEVEL_INFO
+#endif
+
+#if SHADE_LOG_LEVEL >= SHADE_LOG_LEVEL_ERROR
+#define SHADE_LOG_ERROR(fmt, ...)  st::ShadeLog::write(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define SHADE_LOG_ERROR(fmt, ...)  do {} while (0)
+#endif
+
+#if SHADE_LOG_LEVEL >= SHADE_LOG_LEVEL_INFO
+#define SHADE_LOG_INFO(fmt, ...)   st::ShadeLog::write(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define SHADE_LOG_INFO(fmt, ...)   do {} while (0)
+#endif
+
+#if SHADE_LOG_LEVEL >= SHADE_LOG_LEVEL_DEBUG
+#define SHADE_LOG_DEBUG(fmt, ...)  st::ShadeLog::write(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define SHADE_LOG_DEBUG(fmt, ...)  do {} while (0)
+#endif
+
+namespace st
+{
+	class ShadeLog
+	{
+		public:
+			static const unsigned int BUFFER_SIZE = 2048;  //ring size in bytes
+			static const byte LINE_SIZE = 96;              //longest line, longer ones are cut
+
+			//formats one line ("<millis> <text>\n") into the ring - never blocks
+			static void write(PGM_P fmt, ...) __attribute__((format(printf, 1, 2)));
+
+			//moves what Serial can take without blocking - call from loop()
+			static void service();
+
+			//writes everything still in the ring, oldest first
+			static void printTo(Print &out);
+
+			//bytes printTo() will write
+			static unsigned int length();
+
+			static unsigned long droppedBytes() { return s_lDropped; }
+
+		private:
+			static char s_Buffer[BUFFER_SIZE];
+			static unsigned long s_lWritten;               //bytes ever written, the ring holds the last BUFFER_SIZE
+			static unsigned long s_lSerialSent;            //bytes ever written to Serial
+			static unsigned long s_lDropped;               //bytes overwritten before Serial got them
+
+			static unsigned long oldest();
+	};
+}
+
+#endif
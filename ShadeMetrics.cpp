@@ -0,0 +1,116 @@
+//******************************************************************************************
+//  File: ShadeMetrics.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeMetrics.h"
+
+namespace st
+{
+	static const char SUFFIX_BUCKET[] PROGMEM = "_bucket";
+	static const char SUFFIX_SUM[] PROGMEM = "_sum";
+	static const char SUFFIX_COUNT[] PROGMEM = "_count";
+	static const char SUFFIX_MAX[] PROGMEM = "_max";
+	static const char METRIC_HEAP_FREE[] PROGMEM = "heap_free_bytes";
+	static const char METRIC_HEAP_BLOCK[] PROGMEM = "heap_max_block_bytes";
+
+//private
+//printName - metric name, suffix and label set, then the space before the number
+	void ShadeMetrics::printName(Print &out, PGM_P metric, PGM_P suffix, PGM_P label, const char *value)
+	{
+		out.print(FPSTR(metric));
+		if (suffix != NULL) out.print(FPSTR(suffix));
+		if (label != NULL) {
+			out.print('{');
+			out.print(FPSTR(label));
+			out.print(F("=\""));
+			out.print(value);
+			out.print(F("\"}"));
+		}
+		out.print(' ');
+	}
+
+//public
+//printHistogram - buckets are cumulative, as Prometheus expects
+	void ShadeMetrics::printHistogram(Print &out, PGM_P metric, PGM_P label, const char *value, const ShadeHistogram &h)
+	{
+		unsigned long running = 0;
+		for (byte b = 0; b < ShadeHistogram::BUCKETS; b++) {
+			running += h.count[b];
+			out.print(FPSTR(metric));
+			out.print(FPSTR(SUFFIX_BUCKET));
+			out.print('{');
+			if (label != NULL) {
+				out.print(FPSTR(label));
+				out.print(F("=\""));
+				out.print(value);
+				out.print(F("\","));
+			}
+			out.print(F("le=\""));
+			if (b < ShadeHistogram::BUCKETS - 1) {
+				out.print((1UL << (ShadeHistogram::FIRST_SHIFT + b)) - 1);
+			} else {
+				out.print(F("+Inf"));
+			}
+			out.print(F("\"} "));
+			out.println(running);
+		}
+
+		printName(out, metric, SUFFIX_SUM, label, value);
+		//Print has no 64 bit overload
+		if (h.total >> 32) {
+			char buf[21];
+			uint64_t v = h.total;
+			byte i = sizeof(buf) - 1;
+			buf[i] = '\0';
+			do {
+				buf[--i] = '0' + (v % 10);
+				v /= 10;
+			} while (v);
+			out.println(buf + i);
+		} else {
+			out.println((unsigned long)h.total);
+		}
+
+		printName(out, metric, SUFFIX_COUNT, label, value);
+		out.println(h.samples);
+
+		printName(out, metric, SUFFIX_MAX, label, value);
+		out.println(h.max);
+	}
+
+//printValue
+	void ShadeMetrics::printValue(Print &out, PGM_P metric, PGM_P label, const char *value, unsigned long number)
+	{
+		printName(out, metric, NULL, label, value);
+		out.println(number);
+	}
+
+//readHeap
+	ShadeHeap ShadeMetrics::readHeap()
+	{
+		ShadeHeap heap = {0, 0};
+#if defined(ESP8266)
+		heap.freeBytes = ESP.getFreeHeap();
+		heap.maxBlock = ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+		heap.freeBytes = ESP.getFreeHeap();
+		heap.maxBlock = ESP.getMaxAllocHeap();
+#endif
+		return heap;
+	}
+
+//printHeap
+	void ShadeMetrics::printHeap(Print &out, const ShadeHeap &heap)
+	{
+#if defined(ESP8266) || defined(ESP32)
+		printValue(out, METRIC_HEAP_FREE, NULL, NULL, heap.freeBytes);
+		printValue(out, METRIC_HEAP_BLOCK, NULL, NULL, heap.maxBlock);
+#else
+		(void)out;
+		(void)heap;
+#endif
+	}
+}
@@ -0,0 +1,103 @@
+//******************************************************************************************
+//  File: ShadeMetrics.h
+//
+//  Summary:  ShadeMetrics holds the small pieces behind the sketch's /metrics page.
+//
+//			  ShadeHistogram counts samples into power of two buckets - bucket 0 holds everything up to 2^FIRST_SHIFT-1, each
+//			  bucket after it twice the range of the one before, the last one everything above.  Adding a sample is a shift
+//			  loop and an increment, and the struct is plain data so it can sit inside ShadeStats and be cleared with memset.
+//
+//			  cycles() reads the CPU cycle counter on the ESP8266/ESP32 (micros() elsewhere) - cheap enough to bracket each
+//			  loop stage.  At 80MHz the default buckets run from 3us to about 100ms.
+//
+//			  The print functions write Prometheus style text ("name{label="value"} number") to any Print, so a page can be
+//			  measured with a CountingPrint first and then written straight to the client without building it in RAM.
+//			  Anything that can change between the two passes has to be read once before them - the heap does, so it is
+//			  read into a ShadeHeap with readHeap() and the same snapshot is printed both times.
+//
+//******************************************************************************************
+
+#ifndef ST_SHADEMETRICS_H
+#define ST_SHADEMETRICS_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	//power of two histogram - see top of file
+	struct ShadeHistogram
+	{
+		static const byte BUCKETS = 16;
+		static const byte FIRST_SHIFT = 8;
+
+		unsigned long count[BUCKETS];
+		unsigned long samples;
+		unsigned long max;
+		uint64_t total;
+
+		void add(uint32_t value)
+		{
+			uint32_t rest = value >> FIRST_SHIFT;
+			byte b = 0;
+			while (rest && (b < BUCKETS - 1)) {
+				rest >>= 1;
+				b++;
+			}
+			count[b]++;
+			samples++;
+			total += value;
+			if (value > max) max = value;
+		}
+	};
+
+	//heap figures read once for both passes of a page - see top of file
+	struct ShadeHeap
+	{
+		unsigned long freeBytes;
+		unsigned long maxBlock;             //largest free block
+	};
+
+	//Print that only counts - for Content-Length
+	class CountingPrint : public Print
+	{
+		public:
+			CountingPrint() : m_nCount(0) {}
+			virtual size_t write(uint8_t) { m_nCount++; return 1; }
+			virtual size_t write(const uint8_t *, size_t size) { m_nCount += size; return size; }
+			size_t count() const { return m_nCount; }
+
+		private:
+			size_t m_nCount;
+	};
+
+	class ShadeMetrics
+	{
+		public:
+			//free running cycle counter - differences are wrap safe
+			static uint32_t cycles()
+			{
+#if defined(ESP8266) || defined(ESP32)
+				return ESP.getCycleCount();
+#else
+				return micros();
+#endif
+			}
+
+			//<metric>_bucket{<label>="<value>",le="..."}, <metric>_sum, <metric>_count and <metric>_max - label NULL for none
+			static void printHistogram(Print &out, PGM_P metric, PGM_P label, const char *value, const ShadeHistogram &h);
+
+			//<metric>{<label>="<value>"} <number> - label NULL for none
+			static void printValue(Print &out, PGM_P metric, PGM_P label, const char *value, unsigned long number);
+
+			//heap free and largest free block, now - 0 where the board can't tell
+			static ShadeHeap readHeap();
+
+			//heap free and largest free block, as read by readHeap()
+			static void printHeap(Print &out, const ShadeHeap &heap);
+
+		private:
+			static void printName(Print &out, PGM_P metric, PGM_P suffix, PGM_P label, const char *value);
+	};
+}
+
+#endif
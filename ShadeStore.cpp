@@ -0,0 +1,330 @@
+//******************************************************************************************
+//  File: ShadeStore.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeStore.h"
+#include "ShadeLog.h"
+
+#include <EEPROM.h>
+
+//journal entry layout - the CRC always sits in the last two bytes and covers everything before it
+#define ENTRY_SEQ      0
+#define ENTRY_HASH     2
+#define ENTRY_KIND     4
+#define ENTRY_VERSION  5
+#define ENTRY_LENGTH   6
+#define ENTRY_PAYLOAD  7
+#define ENTRY_CRC      (ENTRY_SIZE - 2)
+
+namespace st
+{
+	bool ShadeStore::s_bOpen = false;
+	bool ShadeStore::s_bLegacy = false;
+	unsigned int ShadeStore::s_nLegacyOpen = 0;
+	unsigned int ShadeStore::s_nLegacyClose = 0;
+	uint16_t ShadeStore::s_nSlotHash[ShadeStore::MAX_SLOTS];
+	byte ShadeStore::s_nLive[ShadeStore::MAX_SLOTS][ShadeStore::MAX_KINDS];
+	byte ShadeStore::s_nHead = 0;
+	uint16_t ShadeStore::s_nSeq = 0;
+	ShadeStore::Pending ShadeStore::s_Pending[ShadeStore::MAX_PENDING];
+	byte ShadeStore::s_nPending = 0;
+	unsigned long ShadeStore::s_lLastChangeMillis = 0;
+	ShadeStoreStats ShadeStore::s_Stats;
+
+//private
+//begin - map the EEPROM once, check the header and build the RAM index, formatting any other layout
+	void ShadeStore::begin()
+	{
+		if (s_bOpen) return;
+		s_bOpen = true;
+
+		memset(s_nSlotHash, 0xFF, sizeof(s_nSlotHash));
+		memset(s_nLive, NO_ENTRY, sizeof(s_nLive));
+
+	    #if defined(ESP8266)|| defined(ESP32)
+           EEPROM.begin(STORE_SIZE);
+        #endif
+
+		byte header[HEADER_SIZE];
+		for (byte i = 0; i < HEADER_SIZE; i++) header[i] = EEPROM.read(i);
+
+		uint16_t magic = header[0] | (header[1] << 8);
+		uint16_t crc = header[6] | (header[7] << 8);
+		bool valid = (magic == MAGIC) && (crc == crc16(header, 6));
+
+		if (valid && (header[2] == LAYOUT_VERSION) && (header[3] == ENTRIES) && (header[4] == ENTRY_SIZE)) {
+			scan();
+			return;
+		}
+
+		//the single shade layout kept two unsigned ints at address 0 - hold on to them if they look sane
+		if (!valid) {
+			EEPROM.get(0, s_nLegacyOpen);
+			EEPROM.get(sizeof(int), s_nLegacyClose);
+			s_bLegacy = (s_nLegacyOpen > 0) && (s_nLegacyOpen <= 150) && (s_nLegacyClose > 0) && (s_nLegacyClose <= 150);
+		}
+
+		SHADE_LOG_INFO("ShadeStore::begin - formatting settings store");
+		format();
+		commit();
+	}
+
+//format - write the header and empty the journal (not committed)
+	void ShadeStore::format()
+	{
+		byte header[HEADER_SIZE] = {(byte)(MAGIC & 0xFF), (byte)(MAGIC >> 8), LAYOUT_VERSION, ENTRIES, ENTRY_SIZE, 0, 0, 0};
+		uint16_t crc = crc16(header, 6);
+		header[6] = crc & 0xFF;
+		header[7] = crc >> 8;
+
+		for (byte i = 0; i < HEADER_SIZE; i++) EEPROM.write(i, header[i]);
+		for (int a = entryAddress(0); a < entryAddress(ENTRIES); a++) EEPROM.write(a, 0xFF);
+
+		memset(s_nLive, NO_ENTRY, sizeof(s_nLive));
+		s_nHead = 0;
+		s_nSeq = 0;
+	}
+
+//commit - on the ESP8266/ESP32 this erases and rewrites the flash sector
+	void ShadeStore::commit()
+	{
+    	#if defined(ESP8266)|| defined(ESP32)
+	    	EEPROM.commit();
+		#endif
+		s_Stats.commits++;
+	}
+
+//scan - find the newest entry for every slot and kind, and where the journal carries on
+	void ShadeStore::scan()
+	{
+		byte buf[ENTRY_SIZE];
+		byte newest = NO_ENTRY;
+		uint16_t newestSeq = 0;
+
+		for (byte e = 0; e < ENTRIES; e++) {
+			if (!readEntry(e, buf)) continue;
+
+			uint16_t seq = buf[ENTRY_SEQ] | (buf[ENTRY_SEQ + 1] << 8);
+			byte kind = buf[ENTRY_KIND];
+			byte slot = slotForHash(buf[ENTRY_HASH] | (buf[ENTRY_HASH + 1] << 8), true);
+
+			//sequence numbers wrap, so compare by difference
+			if ((newest == NO_ENTRY) || ((int16_t)(seq - newestSeq) > 0)) {
+				newest = e;
+				newestSeq = seq;
+			}
+
+			if ((slot == NO_SLOT) || (kind >= MAX_KINDS)) continue;
+
+			byte live = s_nLive[slot][kind];
+			if (live != NO_ENTRY) {
+				int a = entryAddress(live) + ENTRY_SEQ;
+				uint16_t liveSeq = EEPROM.read(a) | (EEPROM.read(a + 1) << 8);
+				if ((int16_t)(seq - liveSeq) <= 0) continue;
+			}
+			s_nLive[slot][kind] = e;
+		}
+
+		if (newest != NO_ENTRY) {
+			s_nHead = (newest + 1) % ENTRIES;
+			s_nSeq = newestSeq + 1;
+		}
+	}
+
+//readEntry - false if the entry is empty or damaged
+	bool ShadeStore::readEntry(byte entry, byte *buf)
+	{
+		int a = entryAddress(entry);
+		for (byte i = 0; i < ENTRY_SIZE; i++) buf[i] = EEPROM.read(a + i);
+
+		uint16_t crc = buf[ENTRY_CRC] | (buf[ENTRY_CRC + 1] << 8);
+		return (buf[ENTRY_LENGTH] <= MAX_PAYLOAD) && (crc == crc16(buf, ENTRY_CRC));
+	}
+
+//isLive - true if the entry is the newest record for some slot and kind
+	bool ShadeStore::isLive(byte entry)
+	{
+		for (byte slot = 0; slot < MAX_SLOTS; slot++) {
+			for (byte kind = 0; kind < MAX_KINDS; kind++) {
+				if (s_nLive[slot][kind] == entry) return true;
+			}
+		}
+		return false;
+	}
+
+//append - put the record in the next position round the journal that no live record is using (not committed).  There
+//are more entries than slots times kinds, so one is always free
+	void ShadeStore::append(const Pending &rec)
+	{
+		byte e = s_nHead;
+		for (byte tries = 0; (tries < ENTRIES) && isLive(e); tries++) {
+			e = (e + 1) % ENTRIES;
+		}
+
+		byte buf[ENTRY_SIZE];
+		memset(buf, 0, sizeof(buf));
+		buf[ENTRY_SEQ] = s_nSeq & 0xFF;
+		buf[ENTRY_SEQ + 1] = s_nSeq >> 8;
+		buf[ENTRY_HASH] = s_nSlotHash[rec.slot] & 0xFF;
+		buf[ENTRY_HASH + 1] = s_nSlotHash[rec.slot] >> 8;
+		buf[ENTRY_KIND] = rec.kind;
+		buf[ENTRY_VERSION] = rec.version;
+		buf[ENTRY_LENGTH] = rec.length;
+		memcpy(buf + ENTRY_PAYLOAD, rec.payload, rec.length);
+		uint16_t crc = crc16(buf, ENTRY_CRC);
+		buf[ENTRY_CRC] = crc & 0xFF;
+		buf[ENTRY_CRC + 1] = crc >> 8;
+
+		int a = entryAddress(e);
+		for (byte i = 0; i < ENTRY_SIZE; i++) EEPROM.write(a + i, buf[i]);
+
+		s_nLive[rec.slot][rec.kind] = e;
+		s_nSeq++;
+		s_nHead = (e + 1) % ENTRIES;
+		if (s_nHead == 0) s_Stats.wraps++;
+		s_Stats.entriesWritten++;
+	}
+
+//slotForHash - slot already holding this name hash, or a free one if add is true
+	byte ShadeStore::slotForHash(uint16_t hash, bool add)
+	{
+		byte freeSlot = NO_SLOT;
+
+		for (byte slot = 0; slot < MAX_SLOTS; slot++) {
+			if (s_nSlotHash[slot] == hash) return slot;
+			if ((s_nSlotHash[slot] == 0xFFFF) && (freeSlot == NO_SLOT)) freeSlot = slot;
+		}
+
+		if (add && (freeSlot != NO_SLOT)) s_nSlotHash[freeSlot] = hash;
+		return add ? freeSlot : NO_SLOT;
+	}
+
+//nameHash - never 0xFFFF, which marks a free slot
+	uint16_t ShadeStore::nameHash(const char *name)
+	{
+		uint16_t hash = crc16(name, strlen(name));
+		return (hash == 0xFFFF) ? 0xFFFE : hash;
+	}
+
+//public
+//claimSlot - nothing is written until the first record
+	byte ShadeStore::claimSlot(const char *name)
+	{
+		begin();
+
+		byte slot = slotForHash(nameHash(name), true);
+		if (slot == NO_SLOT) {
+			SHADE_LOG_ERROR("ShadeStore::claimSlot - no free slot for %s", name);
+		}
+		return slot;
+	}
+
+//read - a queued record is newer than anything in the journal
+	bool ShadeStore::read(byte slot, byte kind, byte version, void *data, byte length)
+	{
+		if ((slot >= MAX_SLOTS) || (kind >= MAX_KINDS) || (length > MAX_PAYLOAD)) return false;
+		begin();
+
+		for (byte i = 0; i < s_nPending; i++) {
+			if ((s_Pending[i].slot == slot) && (s_Pending[i].kind == kind)) {
+				if ((s_Pending[i].version != version) || (s_Pending[i].length != length)) return false;
+				memcpy(data, s_Pending[i].payload, length);
+				return true;
+			}
+		}
+
+		byte buf[ENTRY_SIZE];
+		byte live = s_nLive[slot][kind];
+		if ((live == NO_ENTRY) || !readEntry(live, buf)) return false;
+		if ((buf[ENTRY_VERSION] != version) || (buf[ENTRY_LENGTH] != length)) return false;
+
+		memcpy(data, buf + ENTRY_PAYLOAD, length);
+		return true;
+	}
+
+//write
+	bool ShadeStore::write(byte slot, byte kind, byte version, const void *data, byte length)
+	{
+		if ((slot >= MAX_SLOTS) || (kind >= MAX_KINDS) || (length > MAX_PAYLOAD)) return false;
+		begin();
+
+		//already queued - latest wins
+		for (byte i = 0; i < s_nPending; i++) {
+			Pending &p = s_Pending[i];
+			if ((p.slot == slot) && (p.kind == kind)) {
+				if ((p.version == version) && (p.length == length) && (memcmp(p.payload, data, length) == 0)) {
+					s_Stats.writesSkipped++;
+					return true;
+				}
+				p.version = version;
+				p.length = length;
+				memcpy(p.payload, data, length);
+				s_lLastChangeMillis = millis();
+				s_Stats.writesCoalesced++;
+				return true;
+			}
+		}
+
+		//same as what is stored - nothing to do
+		byte buf[ENTRY_SIZE];
+		byte live = s_nLive[slot][kind];
+		if ((live != NO_ENTRY) && readEntry(live, buf) && (buf[ENTRY_VERSION] == version) && (buf[ENTRY_LENGTH] == length) && (memcmp(buf + ENTRY_PAYLOAD, data, length) == 0)) {
+			s_Stats.writesSkipped++;
+			return true;
+		}
+
+		if (s_nPending >= MAX_PENDING) flush();
+
+		Pending &p = s_Pending[s_nPending++];
+		p.slot = slot;
+		p.kind = kind;
+		p.version = version;
+		p.length = length;
+		memcpy(p.payload, data, length);
+		s_lLastChangeMillis = millis();
+		return true;
+	}
+
+//service - flush once things have been quiet for COMMIT_DELAY_MS
+	void ShadeStore::service()
+	{
+		if ((s_nPending > 0) && ((uint32_t)(millis() - s_lLastChangeMillis) >= COMMIT_DELAY_MS)) flush();
+	}
+
+//flush - append everything queued and commit once
+	void ShadeStore::flush()
+	{
+		if (s_nPending == 0) return;
+
+		for (byte i = 0; i < s_nPending; i++) append(s_Pending[i]);
+		s_nPending = 0;
+		commit();
+	}
+
+//takeLegacyTimeouts - every shade asking during the boot that found them gets them
+	bool ShadeStore::takeLegacyTimeouts(unsigned int &open, unsigned int &close)
+	{
+		begin();
+		if (!s_bLegacy) return false;
+
+		open = s_nLegacyOpen;
+		close = s_nLegacyClose;
+		return true;
+	}
+
+//crc16 - CRC-16/CCITT
+	uint16_t ShadeStore::crc16(const void *data, size_t length, uint16_t crc)
+	{
+		const byte *p = (const byte *)data;
+		while (length--) {
+			crc ^= (uint16_t)(*p++) << 8;
+			for (byte i = 0; i < 8; i++) {
+				crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+			}
+		}
+		return crc;
+	}
+}
@@ -0,0 +1,129 @@
+//******************************************************************************************
+//  File: ShadeStore.h
+//
+//  Summary:  ShadeStore is a small persistent record store in EEPROM (flash emulated EEPROM on the ESP8266/ESP32) so
+//			  several IS_DCMotor_ShadeControl instances on one board each keep their own settings.
+//
+//			  Each shade claims a slot by a hash of its device name, so slots follow the name and not the order the
+//			  shades are declared in the sketch.  A slot can hold up to MAX_KINDS different records (settings, state...).
+//			  Every record carries its own version and length and a CRC16, and the store has a header with a magic number
+//			  and a layout version.  A record that fails its checks reads as missing and the caller falls back to its
+//			  sketch values.
+//
+//			  The store is a journal - a write never overwrites a record in place, it appends a new entry with a higher
+//			  sequence number at the next free position, round robin through the whole area, and the newest entry for
+//			  each slot and kind wins.  Positions holding a record still in use are skipped so nothing is lost when the
+//			  journal wraps - there is one entry for every slot and kind plus one, so an append always finds a free one.
+//			  This spreads cell wear on real EEPROM.
+//
+//			  Writes are coalesced - a write that changes nothing is dropped, and changes are held in RAM and flushed
+//			  together COMMIT_DELAY_MS after the last one, so a burst of settings costs one commit.  On the ESP8266/ESP32
+//			  every EEPROM.commit() erases and rewrites the whole flash sector, so getStats().commits is the sector
+//			  erase count.  Call service() often (IS_DCMotor_ShadeControl::update() does) and flush() before a restart.
+//
+//			  Layout
+//				- header (HEADER_SIZE bytes)  magic 'S''H', layout version, entry count, entry size, spare, CRC16
+//				- ENTRIES entries of ENTRY_SIZE bytes  sequence, name hash, kind, version, length, payload, CRC16
+//
+//			  A store with another layout is formatted the first time it is opened.  When there is no store header at all,
+//			  the original single shade layout (open and close timeouts as two unsigned ints at address 0) is handed to
+//			  every shade that has no record of its own during that boot, and each writes it to its slot at once.
+//
+//******************************************************************************************
+
+#ifndef ST_SHADESTORE_H
+#define ST_SHADESTORE_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	//counters since boot
+	struct ShadeStoreStats
+	{
+		unsigned long commits;              //EEPROM.commit() calls - flash sector erases on the ESP8266/ESP32
+		unsigned long entriesWritten;       //journal entries appended
+		unsigned long writesSkipped;        //writes dropped because nothing changed
+		unsigned long writesCoalesced;      //writes merged into one still waiting to be flushed
+		unsigned long wraps;                //times the journal went round the whole area
+	};
+
+	class ShadeStore
+	{
+		public:
+			static const byte NO_SLOT = 0xFF;
+			static const byte MAX_SLOTS = 8;
+			static const byte MAX_KINDS = 4;
+			static const byte ENTRY_SIZE = 32;
+			static const byte MAX_PAYLOAD = ENTRY_SIZE - 9;  //less sequence, name hash, kind, version, length and CRC
+			static const unsigned long COMMIT_DELAY_MS = 5000;
+
+			//slot for this device name, claiming a free one if it has none - NO_SLOT if the store is full
+			static byte claimSlot(const char *name);
+
+			//copies the newest record into data - false if there is none, or it holds another version or length
+			static bool read(byte slot, byte kind, byte version, void *data, byte length);
+
+			//queues the record - written at the next flush, dropped if it matches what is stored
+			static bool write(byte slot, byte kind, byte version, const void *data, byte length);
+
+			//writes anything queued for COMMIT_DELAY_MS - call from the loop
+			static void service();
+
+			//writes anything queued now
+			static void flush();
+
+			//open and close timeouts left by the old single shade layout - false if there were none.  begin() has
+			//already formatted over them, so a caller must write them to its own slot.
+			static bool takeLegacyTimeouts(unsigned int &open, unsigned int &close);
+
+			static const ShadeStoreStats& getStats() { return s_Stats; }
+
+			static uint16_t crc16(const void *data, size_t length, uint16_t crc = 0xFFFF);
+
+		private:
+			static const uint16_t MAGIC = 0x5348;          //'S''H'
+			static const byte LAYOUT_VERSION = 2;
+			static const byte HEADER_SIZE = 8;
+			static const byte ENTRIES = MAX_SLOTS * MAX_KINDS + 1;             //every record live, and one to append to
+			static const int STORE_SIZE = HEADER_SIZE + ENTRIES * ENTRY_SIZE;  //EEPROM.begin() size on the ESP8266/ESP32
+			static const byte NO_ENTRY = 0xFF;
+			static const byte MAX_PENDING = 4;
+
+			//a record waiting to be flushed
+			struct Pending
+			{
+				byte slot;
+				byte kind;
+				byte version;
+				byte length;
+				byte payload[MAX_PAYLOAD];
+			};
+
+			static bool s_bOpen;
+			static bool s_bLegacy;
+			static unsigned int s_nLegacyOpen;
+			static unsigned int s_nLegacyClose;
+			static uint16_t s_nSlotHash[MAX_SLOTS];        //name hash per slot, 0xFFFF when free
+			static byte s_nLive[MAX_SLOTS][MAX_KINDS];     //journal entry holding the newest record, or NO_ENTRY
+			static byte s_nHead;                           //entry the next append starts looking at
+			static uint16_t s_nSeq;                        //sequence number of the next append
+			static Pending s_Pending[MAX_PENDING];
+			static byte s_nPending;
+			static unsigned long s_lLastChangeMillis;
+			static ShadeStoreStats s_Stats;
+
+			static void begin();
+			static void format();
+			static void commit();
+			static void scan();
+			static void append(const Pending &rec);
+			static bool isLive(byte entry);
+			static bool readEntry(byte entry, byte *buf);
+			static byte slotForHash(uint16_t hash, bool add);
+			static int entryAddress(byte entry) { return HEADER_SIZE + entry * ENTRY_SIZE; }
+			static uint16_t nameHash(const char *name);
+	};
+}
+
+#endif
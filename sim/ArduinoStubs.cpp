@@ -0,0 +1,240 @@
+//******************************************************************************************
+//  File: ArduinoStubs.cpp
+//
+//  Host stand-ins for the Arduino core, EEPROM, the ESP object and the ST_Anything classes the shade sources use.
+//  See ShadeSim.h for details
+//
+//******************************************************************************************
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "Everything.h"
+#include "Sensor.h"
+#include "ShadeSim.h"
+#include "HubStandIn.h"
+#include <WiFiUdp.h>
+
+#include <new>
+
+namespace stubs
+{
+	byte pinLevel[64];
+	int pwmValue[64];
+	void (*pinIsr[64])(void);
+	bool countAllocs = false;
+	unsigned long allocs = 0;
+
+	void setInput(byte pin, byte level)
+	{
+		if (pinLevel[pin] == level) return;
+		pinLevel[pin] = level;
+		if (pinIsr[pin] != NULL) pinIsr[pin]();
+	}
+}
+
+//heap allocations - counted while stubs::countAllocs is set
+void *operator new(size_t size)
+{
+	if (stubs::countAllocs) stubs::allocs++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+//time - 32 bits wide and wrapping, as on the board
+unsigned long millis() { return (uint32_t)(sim::ShadeSim::nowMicros() / 1000); }
+unsigned long micros() { return (uint32_t)sim::ShadeSim::nowMicros(); }
+void delay(unsigned long ms) { sim::ShadeSim::advance(ms * 1000); }
+
+//pins
+//switch inputs are driven by the rig from addRig() on, whatever the mode
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	stubs::pinLevel[pin] = value ? HIGH : LOW;
+	stubs::pwmValue[pin] = value ? sim::ShadeSim::PWM_RANGE : 0;
+	sim::ShadeSim::pinChanged();
+}
+
+int digitalRead(uint8_t pin) { return stubs::pinLevel[pin]; }
+
+void analogWrite(uint8_t pin, int value)
+{
+	stubs::pwmValue[pin] = value;
+	sim::ShadeSim::pinChanged();
+}
+
+int analogRead(uint8_t pin) { return sim::ShadeSim::analogValue(pin); }
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int) { stubs::pinIsr[interrupt] = isr; }
+void detachInterrupt(uint8_t interrupt) { stubs::pinIsr[interrupt] = NULL; }
+
+char *ultoa(unsigned long value, char *buf, int radix)
+{
+	char tmp[33];
+	int n = 0;
+	do {
+		unsigned long d = value % radix;
+		tmp[n++] = (char)((d < 10) ? ('0' + d) : ('a' + d - 10));
+		value /= radix;
+	} while (value != 0);
+	for (int i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+	buf[n] = '\0';
+	return buf;
+}
+
+char *utoa(unsigned int value, char *buf, int radix) { return ultoa(value, buf, radix); }
+
+//Print
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--) n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(unsigned long n)
+{
+	char buf[24];
+	return print(ultoa(n, buf, 10));
+}
+
+size_t Print::print(long n)
+{
+	if (n >= 0) return print((unsigned long)n);
+	return print('-') + print((unsigned long)(-n));
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if (sim::ShadeSim::verbose) fputc(c, stdout);
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	if (sim::ShadeSim::verbose) fwrite(buffer, 1, size, stdout);
+	return size;
+}
+
+//ESP - an 80MHz part, and a heap that never changes
+EspClass ESP;
+uint32_t EspClass::getCycleCount() { return (uint32_t)(sim::ShadeSim::nowMicros() * 80); }
+uint32_t EspClass::getFreeHeap() { return 40000; }
+uint32_t EspClass::getMaxFreeBlockSize() { return 30000; }
+
+EEPROMClass EEPROM;
+
+//UDP - one socket, a fixed receive queue and one reply being built
+namespace stubs
+{
+	struct Datagram
+	{
+		uint8_t data[UDP_MAX_SIZE];
+		byte length;
+		uint16_t port;
+	};
+	static Datagram s_UdpQueue[UDP_QUEUE];
+	static byte s_nUdpHead;
+	static byte s_nUdpCount;
+	static Datagram s_UdpCurrent;           //taken by parsePacket()
+	static byte s_nUdpRead;
+	static Datagram s_UdpOut;
+	static uint16_t s_nUdpPort;
+	void (*udpReply)(const uint8_t *data, size_t length, uint16_t toPort) = NULL;
+
+	bool udpSend(const uint8_t *data, size_t length, uint16_t fromPort)
+	{
+		if ((s_nUdpPort == 0) || (s_nUdpCount >= UDP_QUEUE) || (length > UDP_MAX_SIZE)) return false;
+		Datagram &d = s_UdpQueue[(s_nUdpHead + s_nUdpCount++) % UDP_QUEUE];
+		memcpy(d.data, data, length);
+		d.length = (byte)length;
+		d.port = fromPort;
+		return true;
+	}
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+	stubs::s_nUdpPort = port;
+	return 1;
+}
+
+int WiFiUDP::parsePacket()
+{
+	if (stubs::s_nUdpCount == 0) return 0;
+	stubs::s_UdpCurrent = stubs::s_UdpQueue[stubs::s_nUdpHead];
+	stubs::s_nUdpHead = (stubs::s_nUdpHead + 1) % stubs::UDP_QUEUE;
+	stubs::s_nUdpCount--;
+	stubs::s_nUdpRead = 0;
+	return stubs::s_UdpCurrent.length;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t length)
+{
+	size_t n = stubs::s_UdpCurrent.length - stubs::s_nUdpRead;
+	if (n > length) n = length;
+	memcpy(buffer, stubs::s_UdpCurrent.data + stubs::s_nUdpRead, n);
+	stubs::s_nUdpRead += n;
+	return (int)n;
+}
+
+int WiFiUDP::beginPacket(IPAddress, uint16_t port)
+{
+	stubs::s_UdpOut.length = 0;
+	stubs::s_UdpOut.port = port;
+	return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+	size_t room = stubs::UDP_MAX_SIZE - stubs::s_UdpOut.length;
+	if (size > room) size = room;
+	memcpy(stubs::s_UdpOut.data + stubs::s_UdpOut.length, buffer, size);
+	stubs::s_UdpOut.length += size;
+	return size;
+}
+
+int WiFiUDP::endPacket()
+{
+	if (stubs::udpReply != NULL) stubs::udpReply(stubs::s_UdpOut.data, stubs::s_UdpOut.length, stubs::s_UdpOut.port);
+	return 1;
+}
+
+IPAddress WiFiUDP::remoteIP() { return IPAddress(0xC0A80164); }
+uint16_t WiFiUDP::remotePort() { return stubs::s_UdpCurrent.port; }
+
+//ST_Anything
+namespace st
+{
+	bool Device::debug = false;
+	bool Sensor::debug = false;
+	bool Everything::debug = false;
+	byte Everything::bTimersPending = 0;
+	SmartThings *Everything::SmartThing = NULL;
+
+	void Everything::sendSmartString(const String &str)
+	{
+		String copy = str;
+		sendSmartStringNow(copy);
+	}
+
+	void Everything::sendSmartStringNow(String &str)
+	{
+		//recording is the harness's cost, not the shade's
+		bool counting = stubs::countAllocs;
+		stubs::countAllocs = false;
+		sim::ShadeSim::messages().push_back(str.c_str());
+		if (sim::HubStandIn::running()) sim::HubStandIn::post(str.c_str());
+		if (sim::ShadeSim::verbose) printf("%10.3f hub <- %s\n", sim::ShadeSim::nowMicros() / 1000000.0, str.c_str());
+		stubs::countAllocs = counting;
+	}
+}
@@ -0,0 +1,234 @@
+//******************************************************************************************
+//  File: HubStandIn.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "HubStandIn.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sim
+{
+	static const char PARENT_ID[] = "17";          //the parent's device.id
+
+	int HubStandIn::s_nListen = -1;
+	unsigned short HubStandIn::s_nPort = 0;
+	std::vector<HubStandIn::Child> HubStandIn::s_Children;
+	std::vector<std::pair<std::string, std::string> > HubStandIn::s_DniCache;
+	std::vector<HubEvent> HubStandIn::s_Events;
+	unsigned long HubStandIn::posts = 0;
+	unsigned long HubStandIn::badRequests = 0;
+	unsigned long HubStandIn::childScans = 0;
+	unsigned long HubStandIn::cacheHits = 0;
+
+//private
+//split - Groovy's String.split() on a single character, trailing empty strings dropped
+	std::vector<std::string> HubStandIn::split(const std::string &text, char separator)
+	{
+		std::vector<std::string> parts;
+		size_t start = 0;
+		for (;;) {
+			size_t end = text.find(separator, start);
+			parts.push_back(text.substr(start, (end == std::string::npos) ? std::string::npos : end - start));
+			if (end == std::string::npos) break;
+			start = end + 1;
+		}
+		while (!parts.empty() && parts.back().empty()) parts.pop_back();
+		return parts;
+	}
+
+//serve - one connection: the request line, the headers, Content-Length bytes of body, then 200 and close
+	void HubStandIn::serve()
+	{
+		int fd = accept(s_nListen, NULL, NULL);
+		if (fd < 0) {
+			badRequests++;
+			return;
+		}
+
+		std::string request;
+		size_t bodyStart = std::string::npos;
+		long length = -1;
+		char buf[512];
+		for (;;) {
+			if (bodyStart == std::string::npos) {
+				size_t end = request.find("\r\n\r\n");
+				if (end != std::string::npos) {
+					bodyStart = end + 4;
+					std::string headers = request.substr(0, end);
+					for (char &c : headers) c = (char)toupper((unsigned char)c);
+					size_t at = headers.find("\r\nCONTENT-LENGTH:");
+					if (at != std::string::npos) length = strtol(headers.c_str() + at + 17, NULL, 10);
+					if ((headers.compare(0, 7, "POST / ") != 0) || (length < 0)) break;
+				}
+			}
+			if ((bodyStart != std::string::npos) && (request.size() >= bodyStart + length)) break;
+			ssize_t n = read(fd, buf, sizeof(buf));
+			if (n <= 0) break;
+			request.append(buf, n);
+		}
+
+		bool ok = (bodyStart != std::string::npos) && (length >= 0) && (request.size() >= bodyStart + length);
+		const char *reply = ok ? "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n" : "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+		if (write(fd, reply, strlen(reply)) < 0) ok = false;
+		close(fd);
+
+		if (!ok) {
+			badRequests++;
+			return;
+		}
+		posts++;
+		parse(request.substr(bodyStart, length));
+	}
+
+//parse - the parent driver's parse() for a child's message
+	void HubStandIn::parse(const std::string &body)
+	{
+		std::vector<std::string> parts = split(body, ' ');
+		if (parts.size() < 2) {
+			badRequests++;
+			return;
+		}
+		const std::string &name = parts[0];
+		const std::string &value = parts[1];
+
+		//name.split("\\d+", 2) - the base before the first digit, the number after it
+		size_t digit = name.find_first_of("0123456789");
+		if (digit == std::string::npos) {
+			badRequests++;                  //not a child - the parent would keep it as its own event
+			return;
+		}
+		std::string namebase = name.substr(0, digit);
+
+		Child *child = findChildDevice(name);
+		if (child == NULL) {
+			Child created = {std::string(PARENT_ID) + "-" + name, namebase};
+			s_Children.push_back(created);
+			child = findChildDevice(name);
+		}
+
+		//a batched frame carries several values separated by ';' - the child gets them one at a time
+		std::vector<std::string> values = split(value, ';');
+		for (const std::string &v : values) childParse(*child, namebase + " " + v);
+	}
+
+//findChildDevice - cached DNI first, then a scan of the child devices - the scan result is cached for next time
+	HubStandIn::Child *HubStandIn::findChildDevice(const std::string &name)
+	{
+		std::string key = std::string(PARENT_ID) + "-" + name;
+		for (const std::pair<std::string, std::string> &entry : s_DniCache) {
+			if (entry.first != key) continue;
+			for (Child &c : s_Children) {
+				if (c.dni == entry.second) {
+					cacheHits++;
+					return &c;
+				}
+			}
+		}
+
+		childScans++;
+		for (Child &c : s_Children) {
+			if (c.dni == key) {
+				s_DniCache.push_back(std::make_pair(key, c.dni));
+				return &c;
+			}
+		}
+		return NULL;
+	}
+
+//childParse - the Child Window DC Shade driver's parse()
+	void HubStandIn::childParse(const Child &child, const std::string &description)
+	{
+		std::vector<std::string> parts = split(description, ' ');
+		std::string name = (parts.size() > 0) ? parts[0] : "";
+		std::string value = (parts.size() > 1) ? parts[1] : "";
+		std::vector<std::string> newparts = split(value, ':');
+
+		HubEvent e = {child.dni, name, value};
+		if (newparts.size() > 1) {
+			e.name = newparts[0];
+			e.value = newparts[1];
+			if (e.name == "obstruction") e.value = (e.value == "1") ? "detected" : "clear";
+		} else if (!name.empty() && !value.empty()) {
+			if (name == "windowDCShade") e.name = "windowShade";
+			if (value == "partially_open") e.value = "partially open";
+		} else {
+			badRequests++;
+			return;
+		}
+		s_Events.push_back(e);
+	}
+
+//public
+//begin
+	bool HubStandIn::begin()
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) return false;
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t len = sizeof(addr);
+		if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(fd, 4) != 0) ||
+			(getsockname(fd, (struct sockaddr *)&addr, &len) != 0)) {
+			close(fd);
+			return false;
+		}
+		s_nListen = fd;
+		s_nPort = ntohs(addr.sin_port);
+		return true;
+	}
+
+//post - connect, write the request, and serve it here before reading the reply - the kernel queues the connection
+//and the request, so one thread does both ends
+	void HubStandIn::post(const char *message)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(s_nPort);
+		if ((fd < 0) || (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)) {
+			if (fd >= 0) close(fd);
+			badRequests++;
+			return;
+		}
+
+		//what SmartThingsESP8266WiFi::send() writes - println() ends the body with CRLF past Content-Length
+		char head[160];
+		int n = snprintf(head, sizeof(head), "POST / HTTP/1.1\r\nHOST: 127.0.0.1:%u\r\nCONTENT-TYPE: text\r\nCONTENT-LENGTH: %u\r\n\r\n",
+			(unsigned int)s_nPort, (unsigned int)strlen(message));
+		std::string request(head, n);
+		request += message;
+		request += "\r\n";
+		if (write(fd, request.data(), request.size()) != (ssize_t)request.size()) badRequests++;
+
+		serve();
+
+		char reply[128];
+		ssize_t got = read(fd, reply, sizeof(reply) - 1);
+		if ((got < 12) || (strncmp(reply, "HTTP/1.1 200", 12) != 0)) badRequests++;
+		close(fd);
+	}
+
+//childEvents
+	std::vector<HubEvent> HubStandIn::childEvents(const char *name)
+	{
+		std::string dni = std::string(PARENT_ID) + "-" + name;
+		std::vector<HubEvent> events;
+		for (const HubEvent &e : s_Events) if (e.dni == dni) events.push_back(e);
+		return events;
+	}
+}
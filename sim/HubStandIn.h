@@ -0,0 +1,72 @@
+//******************************************************************************************
+//  File: HubStandIn.h
+//
+//  Summary:  HubStandIn is a local stand-in for the Hubitat hub - an HTTP server on 127.0.0.1 that takes the POSTs
+//			  SmartThingsESP8266WiFi::send() makes and runs each body through the HubDuino Parent Ethernet driver's
+//			  parse() and the Child Window DC Shade driver's parse(), line for line in C++:
+//				- the body is split on ' ' into name and value, and the name into its base and number
+//				- the child is found by the cached DNI first, then by a scan of the children that fills the cache,
+//				  and created on the first message for it
+//				- a batched frame's value is split on ';' and the child parses "<namebase> <item>" for each item
+//				- the child turns "<attr>:<value>" and "windowDCShade <state>" into events
+//			  Everything::sendSmartStringNow() posts every hub message to it once begin() has run.  Nothing here is
+//			  built for the board.
+//
+//******************************************************************************************
+
+#ifndef SIM_HUBSTANDIN_H
+#define SIM_HUBSTANDIN_H
+
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	//one sendEvent() from a child driver
+	struct HubEvent
+	{
+		std::string dni;
+		std::string name;
+		std::string value;
+	};
+
+	class HubStandIn
+	{
+		public:
+			//listens on an ephemeral 127.0.0.1 port - false if it can't
+			static bool begin();
+			static bool running() { return s_nListen >= 0; }
+
+			//the board's side - one POST, as SmartThingsESP8266WiFi::send() writes it, answered before it returns
+			static void post(const char *message);
+
+			static const std::vector<HubEvent> &events() { return s_Events; }
+			static std::vector<HubEvent> childEvents(const char *name);   //the events of the child for this name
+
+			static unsigned long posts;         //requests answered 200
+			static unsigned long badRequests;   //requests that didn't parse, or a body that isn't Content-Length long
+			static unsigned long childScans;    //findChildDevice() lookups that missed the DNI cache
+			static unsigned long cacheHits;     //findChildDevice() lookups the DNI cache answered
+
+		private:
+			struct Child
+			{
+				std::string dni;
+				std::string namebase;
+			};
+
+			static int s_nListen;
+			static unsigned short s_nPort;
+			static std::vector<Child> s_Children;
+			static std::vector<std::pair<std::string, std::string> > s_DniCache;
+			static std::vector<HubEvent> s_Events;
+
+			static void serve();
+			static void parse(const std::string &body);
+			static Child *findChildDevice(const std::string &name);
+			static void childParse(const Child &child, const std::string &description);
+			static std::vector<std::string> split(const std::string &text, char separator);
+	};
+}
+
+#endif
@@ -0,0 +1,211 @@
+//******************************************************************************************
+//  File: ShadeSim.cpp
+//
+//  See .h for details
+//
+//******************************************************************************************
+
+#include "ShadeSim.h"
+
+namespace sim
+{
+	ShadeSim::Rig ShadeSim::s_Rigs[ShadeSim::MAX_RIGS];
+	byte ShadeSim::s_nRigs = 0;
+	unsigned long ShadeSim::s_lMicros = 0;
+	std::vector<std::string> ShadeSim::s_Messages;
+	bool ShadeSim::verbose = false;
+
+//private
+//writeSwitches - switch inputs from the position, the interrupt handler runs on a change
+	void ShadeSim::writeSwitches(Rig &rig)
+	{
+		const ShadeRig &c = rig.config;
+		RigState &s = rig.state;
+		byte active = c.switchActiveLow ? LOW : HIGH;
+		byte idle = c.switchActiveLow ? HIGH : LOW;
+
+		bool swOpen = (s.position >= 100.0f);
+		bool swClose = (s.position <= 0.0f);
+		int d = drive(&rig - s_Rigs);
+
+		//a trip is the switch at the end being moved towards going active - an end without one is left to the timeout
+		if (swOpen && !s.swOpen && (c.pinSWOpen != 0) && ((d > 0) || (s.speed > 0.0f))) {
+			ShadeTrip trip = {true, s_lMicros, (d > 0) ? 0UL : s_lMicros, 0.0f, false};
+			s.trips.push_back(trip);
+		}
+		if (swClose && !s.swClose && (c.pinSWClose != 0) && ((d < 0) || (s.speed < 0.0f))) {
+			ShadeTrip trip = {false, s_lMicros, (d < 0) ? 0UL : s_lMicros, 0.0f, false};
+			s.trips.push_back(trip);
+		}
+		s.swOpen = swOpen;
+		s.swClose = swClose;
+
+		if (c.pinSWOpen != 0) stubs::setInput(c.pinSWOpen, swOpen ? active : idle);
+		if (c.pinSWClose != 0) stubs::setInput(c.pinSWClose, swClose ? active : idle);
+	}
+
+//step - motor, tube and switches over micros
+	void ShadeSim::step(Rig &rig, unsigned long micros)
+	{
+		const ShadeRig &c = rig.config;
+		RigState &s = rig.state;
+		int d = drive(&rig - s_Rigs);
+		float ms = micros / 1000.0f;
+
+		//first order lag towards the speed the duty asks for
+		float target = 0.0f;
+		if (d > 0) target = (100.0f * d) / (PWM_RANGE * (float)c.openTravelMillis);
+		if (d < 0) target = (100.0f * d) / (PWM_RANGE * (float)c.closeTravelMillis);
+		float k = ms / (float)c.tauMillis;
+		s.speed += (target - s.speed) * ((k < 1.0f) ? k : 1.0f);
+		float from = s.position;
+		s.position += s.speed * ms;
+
+		//against a hard stop the shade is jammed until driven away
+		s.jammed = false;
+		if (s.position >= 100.0f + c.hardStopPercent) {
+			s.position = 100.0f + c.hardStopPercent;
+			s.speed = 0.0f;
+			s.jammed = (d > 0);
+		} else if (s.position <= -c.hardStopPercent) {
+			s.position = -c.hardStopPercent;
+			s.speed = 0.0f;
+			s.jammed = (d < 0);
+		} else if ((s.obstacle >= 0.0f) && (((from > s.obstacle) && (s.position <= s.obstacle)) || ((from < s.obstacle) && (s.position >= s.obstacle)) || (from == s.obstacle))) {
+			s.position = s.obstacle;
+			s.speed = 0.0f;
+			s.jammed = (d != 0);
+		}
+
+		if (d > 0) s.driveOpenMicros += micros;
+		if (d < 0) s.driveCloseMicros += micros;
+
+		//how far the last trip ran on
+		if (!s.trips.empty()) {
+			ShadeTrip &trip = s.trips.back();
+			float past = trip.opening ? (s.position - 100.0f) : -s.position;
+			if (past > trip.overshootPercent) trip.overshootPercent = past;
+			if (past >= c.hardStopPercent) trip.hitHardStop = true;
+		}
+
+		writeSwitches(rig);
+	}
+
+//public
+//addRig
+	byte ShadeSim::addRig(const ShadeRig &rig)
+	{
+		Rig &r = s_Rigs[s_nRigs];
+		r.config = rig;
+		r.state = RigState();
+		r.state.position = rig.position;
+		r.state.minReverseGap = 0xFFFFFFFF;
+		r.state.obstacle = -1.0f;
+		r.state.swOpen = (rig.position >= 100.0f);
+		r.state.swClose = (rig.position <= 0.0f);
+		byte active = rig.switchActiveLow ? LOW : HIGH;
+		byte idle = rig.switchActiveLow ? HIGH : LOW;
+		if (rig.pinSWOpen != 0) stubs::pinLevel[rig.pinSWOpen] = r.state.swOpen ? active : idle;
+		if (rig.pinSWClose != 0) stubs::pinLevel[rig.pinSWClose] = r.state.swClose ? active : idle;
+		return s_nRigs++;
+	}
+
+//moveByHand - as if someone wound the shade there with the power off
+	void ShadeSim::moveByHand(byte rig, float position)
+	{
+		Rig &r = s_Rigs[rig];
+		r.state.position = position;
+		r.state.speed = 0.0f;
+		writeSwitches(r);
+	}
+
+//advance
+	void ShadeSim::advance(unsigned long micros)
+	{
+		while (micros > 0) {
+			unsigned long dt = (micros < SUBSTEP_MICROS) ? micros : SUBSTEP_MICROS;
+			s_lMicros += dt;
+			micros -= dt;
+			for (byte i = 0; i < s_nRigs; i++) step(s_Rigs[i], dt);
+		}
+	}
+
+//drive - what the bridge puts on the motor
+	int ShadeSim::drive(byte rig)
+	{
+		const ShadeRig &c = s_Rigs[rig].config;
+		byte on = c.invertOutputs ? LOW : HIGH;
+		bool openOn = (stubs::pinLevel[c.pinOpen] == on);
+		bool closeOn = (stubs::pinLevel[c.pinClose] == on);
+		if (openOn == closeOn) return 0;        //both on is a brake on the L298N - bothOnCount() catches it
+		int duty = stubs::pwmValue[c.pinPWM];
+		return openOn ? duty : -duty;
+	}
+
+	unsigned long ShadeSim::driveMicros(byte rig, int direction)
+	{
+		return (direction > 0) ? s_Rigs[rig].state.driveOpenMicros : s_Rigs[rig].state.driveCloseMicros;
+	}
+
+	unsigned long ShadeSim::bothOnCount(byte rig) { return s_Rigs[rig].state.bothOn; }
+	unsigned long ShadeSim::minReverseGapMicros(byte rig) { return s_Rigs[rig].state.minReverseGap; }
+
+	unsigned long ShadeSim::countMessages(const char *text)
+	{
+		unsigned long n = 0;
+		for (size_t i = 0; i < s_Messages.size(); i++) {
+			if (s_Messages[i].find(text) != std::string::npos) n++;
+		}
+		return n;
+	}
+
+//pinChanged - an output moved, note drive cuts and reversals at the exact virtual time
+	void ShadeSim::pinChanged()
+	{
+		for (byte i = 0; i < s_nRigs; i++) {
+			const ShadeRig &c = s_Rigs[i].config;
+			RigState &s = s_Rigs[i].state;
+			byte on = c.invertOutputs ? LOW : HIGH;
+			if ((stubs::pinLevel[c.pinOpen] == on) && (stubs::pinLevel[c.pinClose] == on)) s.bothOn++;
+
+			int d = drive(i);
+			int dir = (d > 0) ? 1 : ((d < 0) ? -1 : 0);
+			int lastDir = (s.lastDrive > 0) ? 1 : ((s.lastDrive < 0) ? -1 : 0);
+			if (dir == lastDir) {
+				s.lastDrive = d;
+				continue;
+			}
+
+			//drive towards a tripped switch ended
+			if (!s.trips.empty()) {
+				ShadeTrip &trip = s.trips.back();
+				if ((trip.cutMicros == 0) && (dir != (trip.opening ? 1 : -1))) trip.cutMicros = s_lMicros;
+			}
+
+			if (dir == 0) {
+				s.offSinceMicros = s_lMicros;
+			} else {
+				//a start - how long the motor was off, if the last drive was the other way
+				if (lastDir != 0) {
+					s.minReverseGap = 0;
+				} else if ((s.lastMoveDir != 0) && (s.lastMoveDir != dir)) {
+					unsigned long gap = s_lMicros - s.offSinceMicros;
+					if (gap < s.minReverseGap) s.minReverseGap = gap;
+				}
+				s.lastMoveDir = dir;
+			}
+			s.lastDrive = d;
+		}
+	}
+
+//analogValue - motor current on the rig's current pin, high when jammed against a hard stop
+	int ShadeSim::analogValue(byte pin)
+	{
+		for (byte i = 0; i < s_nRigs; i++) {
+			if ((pin == 0) || (s_Rigs[i].config.pinCurrent != pin)) continue;
+			if (drive(i) == 0) return 0;
+			return s_Rigs[i].state.jammed ? 900 : 200;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,137 @@
+//******************************************************************************************
+//  File: ShadeSim.h
+//
+//  Summary:  ShadeSim is the host side stand-in for the shade hardware - an L298N, a DC motor with a first order
+//			  speed lag, the shade tube and its limit switches - so the real IS_DCMotor_ShadeControl.cpp can be run
+//			  on Linux (see shade_sim.cpp and the Makefile in this folder).  Nothing here is built for the board.
+//
+//			  Time is virtual.  millis(), micros() and ESP.getCycleCount() read ShadeSim's clock, which only moves in
+//			  advance(), in SUBSTEP_MICROS steps.  They are cut to 32 bits like the board's, so a scenario that starts the
+//			  clock near the top with setClock() sees them wrap.  Each step reads the motor outputs the shade wrote, moves the shade,
+//			  drives the switch inputs and calls the switch interrupt handler on a change, like the board would.
+//
+//			  Position is in percent, 0 closed to 100 open.  A switch is active at its end and beyond, and the shade
+//			  jams against a hard stop hardStopPercent past the end.  Every switch trip is recorded with the virtual time
+//			  to the drive being cut (trip to stop latency) and how far the shade ran on past the switch (overshoot).
+//			  setObstacle() puts something in the way part way down.  Jammed, the motor current on pinCurrent goes up.
+//
+//******************************************************************************************
+
+#ifndef SIM_SHADESIM_H
+#define SIM_SHADESIM_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+	//one shade's wiring and mechanics
+	struct ShadeRig
+	{
+		byte pinOpen;                       //motor outputs, as given to the shade
+		byte pinClose;
+		byte pinPWM;
+		byte pinSWOpen;                     //0 = no switch at that end
+		byte pinSWClose;
+		bool switchActiveLow;
+		bool invertOutputs;
+		byte pinCurrent;                    //analogRead() pin for the motor current, 0 = none
+		unsigned long openTravelMillis;     //full speed, closed to open
+		unsigned long closeTravelMillis;
+		unsigned long tauMillis;            //motor and tube speed lag
+		float hardStopPercent;              //past either end
+		float position;                     //start position
+	};
+
+	//one switch trip while driving towards it
+	struct ShadeTrip
+	{
+		bool opening;
+		unsigned long tripMicros;           //switch went active
+		unsigned long cutMicros;            //drive cut - 0 while still driving
+		float overshootPercent;             //furthest past the switch before the shade came to rest
+		bool hitHardStop;
+	};
+
+	class ShadeSim
+	{
+		public:
+			static const unsigned long SUBSTEP_MICROS = 100;
+			static const byte MAX_RIGS = 4;
+			static const int PWM_RANGE = 1023;
+
+			//wires up a shade - call before constructing it, returns the rig index
+			static byte addRig(const ShadeRig &rig);
+
+			//runs the hardware on for the given virtual time
+			static void advance(unsigned long micros);
+
+			static unsigned long nowMicros() { return s_lMicros; }
+			static void setClock(unsigned long micros) { s_lMicros = micros; }   //before the first advance()
+			static ShadeRig &config(byte rig) { return s_Rigs[rig].config; }
+			static void moveByHand(byte rig, float position);  //at rest somewhere else, motor off
+			static void setObstacle(byte rig, float percent) { s_Rigs[rig].state.obstacle = percent; }  //-1 = none
+			static float position(byte rig) { return s_Rigs[rig].state.position; }
+			static float speed(byte rig) { return s_Rigs[rig].state.speed; }
+			static int drive(byte rig);         //-PWM_RANGE closing .. +PWM_RANGE opening
+			static unsigned long driveMicros(byte rig, int direction);  //total time driven that way
+			static const std::vector<ShadeTrip> &trips(byte rig) { return s_Rigs[rig].state.trips; }
+			static unsigned long bothOnCount(byte rig);  //steps with both direction outputs on
+			static unsigned long minReverseGapMicros(byte rig);  //shortest off time between opposite drives
+			static void clearTrips(byte rig) { s_Rigs[rig].state.trips.clear(); }  //measure from the next move on
+
+			//hub messages seen by Everything::sendSmartStringNow()
+			static std::vector<std::string> &messages() { return s_Messages; }
+			static unsigned long countMessages(const char *text);   //messages containing text
+			static bool verbose;                //print hub messages and Serial output
+
+			//the stubs call these
+			static void pinChanged();
+			static int analogValue(byte pin);
+
+		private:
+			struct RigState
+			{
+				float position;
+				float speed;                    //percent per millisecond, + opening
+				bool swOpen;
+				bool swClose;
+				int lastDrive;
+				int lastMoveDir;                //direction of the last drive, 0 before the first
+				unsigned long offSinceMicros;
+				unsigned long minReverseGap;
+				unsigned long driveOpenMicros;
+				unsigned long driveCloseMicros;
+				unsigned long bothOn;
+				bool jammed;
+				float obstacle;                 //the shade jams here in either direction, -1 when clear
+				std::vector<ShadeTrip> trips;
+			};
+			struct Rig
+			{
+				ShadeRig config;
+				RigState state;
+			};
+			static Rig s_Rigs[MAX_RIGS];
+			static byte s_nRigs;
+			static unsigned long s_lMicros;
+			static std::vector<std::string> s_Messages;
+
+			static void writeSwitches(Rig &rig);
+			static void step(Rig &rig, unsigned long micros);
+	};
+}
+
+//stub internals shared with ShadeSim - ArduinoStubs.cpp
+namespace stubs
+{
+	extern byte pinLevel[64];
+	extern int pwmValue[64];
+	extern bool countAllocs;            //count operator new calls while true
+	extern unsigned long allocs;
+	extern void (*pinIsr[64])(void);
+	void setInput(byte pin, byte level);    //drives an input and calls its interrupt handler on a change
+}
+
+#endif
@@ -0,0 +1,124 @@
+//******************************************************************************************
+//  File: Arduino.h
+//
+//  Summary:  Host stand-in for the Arduino core - just what the shade sources use.  Time is the simulator's virtual
+//			  clock, pins are an array the simulated shade reads and drives, and the PROGMEM helpers are plain RAM
+//			  versions.  See ShadeSim.h.
+//
+//******************************************************************************************
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+
+#define ESP8266          //the sketch's board - selects the ESP code paths in the shade sources
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+
+//flash strings are ordinary strings on the host
+#define PROGMEM
+typedef const char *PGM_P;
+class __FlashStringHelper;
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_ptr(p) (*(const void * const *)(p))
+#define strncpy_P strncpy
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+#define IRAM_ATTR
+#define digitalPinToInterrupt(p) (p)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+char *ultoa(unsigned long value, char *buf, int radix);
+char *utoa(unsigned int value, char *buf, int radix);
+
+class String
+{
+	public:
+		String() {}
+		String(const char *s) : m_s(s ? s : "") {}
+		String(const __FlashStringHelper *s) : m_s(s ? (const char *)s : "") {}
+		String &operator=(const char *s) { m_s = s ? s : ""; return *this; }
+		bool reserve(unsigned int size) { m_s.reserve(size); return true; }
+		const char *c_str() const { return m_s.c_str(); }
+		unsigned int length() const { return m_s.size(); }
+
+	private:
+		std::string m_s;
+};
+
+class Print
+{
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buffer, size_t size);
+		size_t print(const __FlashStringHelper *s) { return print((const char *)s); }
+		size_t print(const String &s) { return print(s.c_str()); }
+		size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(unsigned long n);
+		size_t print(long n);
+		size_t print(unsigned int n) { return print((unsigned long)n); }
+		size_t print(int n) { return print((long)n); }
+		size_t println() { return print("\r\n"); }
+		size_t println(const __FlashStringHelper *s) { return print(s) + println(); }
+		size_t println(const String &s) { return print(s) + println(); }
+		size_t println(const char *s) { return print(s) + println(); }
+		size_t println(unsigned long n) { return print(n) + println(); }
+		size_t println(long n) { return print(n) + println(); }
+		size_t println(unsigned int n) { return print(n) + println(); }
+		size_t println(int n) { return print(n) + println(); }
+};
+
+//Serial - output is thrown away unless ShadeSim::verbose, and it never blocks
+class HardwareSerial : public Print
+{
+	public:
+		using Print::write;
+		void begin(unsigned long) {}
+		int availableForWrite() { return 128; }
+		virtual size_t write(uint8_t c);
+		virtual size_t write(const uint8_t *buffer, size_t size);
+};
+extern HardwareSerial Serial;
+
+class EspClass
+{
+	public:
+		uint32_t getCycleCount();           //80 per virtual microsecond
+		uint32_t getFreeHeap();
+		uint32_t getMaxFreeBlockSize();
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,11 @@
+//******************************************************************************************
+//  File: Constants.h
+//
+//  Summary:  Host stand-in for the ST_Anything Constants.h - nothing the shade sources need.
+//
+//******************************************************************************************
+
+#ifndef SIM_CONSTANTS_H
+#define SIM_CONSTANTS_H
+
+#endif
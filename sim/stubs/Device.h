@@ -0,0 +1,28 @@
+//******************************************************************************************
+//  File: Device.h
+//
+//  Summary:  Host stand-in for the ST_Anything Device class.
+//
+//******************************************************************************************
+
+#ifndef SIM_DEVICE_H
+#define SIM_DEVICE_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	class Device
+	{
+		public:
+			Device() {}
+			virtual ~Device() {}
+			virtual void init() {}
+			virtual void update() {}
+			virtual void beSmart(const String &) {}
+			virtual void refresh() {}
+			static bool debug;
+	};
+}
+
+#endif
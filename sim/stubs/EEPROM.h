@@ -0,0 +1,53 @@
+//******************************************************************************************
+//  File: EEPROM.h
+//
+//  Summary:  Host stand-in for the ESP8266 flash emulated EEPROM, erased (0xFF) at start.  Writes go to the RAM copy
+//			  and only commit() copies it to flash, so a power cut keeps what was committed.  commit() is counted so a
+//			  scenario can report flash sector erases.
+//
+//******************************************************************************************
+
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+	public:
+		static const int SIZE = 4096;
+
+		EEPROMClass() : m_nCommits(0)
+		{
+			memset(m_Data, 0xFF, sizeof(m_Data));
+			memset(m_Flash, 0xFF, sizeof(m_Flash));
+		}
+		void begin(int) {}
+		bool commit()
+		{
+			memcpy(m_Flash, m_Data, sizeof(m_Flash));
+			m_nCommits++;
+			return true;
+		}
+		uint8_t read(int address) { return m_Data[address]; }
+		void write(int address, uint8_t value) { m_Data[address] = value; }
+		template<typename T> T &get(int address, T &t) { memcpy(&t, m_Data + address, sizeof(T)); return t; }
+		template<typename T> const T &put(int address, const T &t) { memcpy(m_Data + address, &t, sizeof(T)); return t; }
+		unsigned long commits() const { return m_nCommits; }
+
+		//the flash sector, and a boot that finds it written
+		const uint8_t *flash() const { return m_Flash; }
+		void powerUp(const uint8_t *flash)
+		{
+			memcpy(m_Flash, flash, sizeof(m_Flash));
+			memcpy(m_Data, flash, sizeof(m_Data));
+		}
+
+	private:
+		uint8_t m_Data[SIZE];
+		uint8_t m_Flash[SIZE];
+		unsigned long m_nCommits;
+};
+extern EEPROMClass EEPROM;
+
+#endif
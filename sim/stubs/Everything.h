@@ -0,0 +1,29 @@
+//******************************************************************************************
+//  File: Everything.h
+//
+//  Summary:  Host stand-in for the ST_Anything Everything class.  sendSmartStringNow() hands each hub message to the
+//			  simulator, which counts it (and prints it with -v), and posts it to HubStandIn when that is running.
+//
+//******************************************************************************************
+
+#ifndef SIM_EVERYTHING_H
+#define SIM_EVERYTHING_H
+
+#include <Arduino.h>
+
+namespace st
+{
+	class SmartThings;
+
+	class Everything
+	{
+		public:
+			static void sendSmartString(const String &str);
+			static void sendSmartStringNow(String &str);
+			static SmartThings *SmartThing;
+			static byte bTimersPending;
+			static bool debug;
+	};
+}
+
+#endif
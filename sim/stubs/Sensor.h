@@ -0,0 +1,28 @@
+//******************************************************************************************
+//  File: Sensor.h
+//
+//  Summary:  Host stand-in for the ST_Anything Sensor class.
+//
+//******************************************************************************************
+
+#ifndef SIM_SENSOR_H
+#define SIM_SENSOR_H
+
+#include "Device.h"
+
+namespace st
+{
+	class Sensor : public Device
+	{
+		public:
+			Sensor(const __FlashStringHelper *name) : m_sName(name) {}
+			virtual ~Sensor() {}
+			const String &getName() const { return m_sName; }
+			static bool debug;
+
+		private:
+			String m_sName;
+	};
+}
+
+#endif
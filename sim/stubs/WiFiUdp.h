@@ -0,0 +1,51 @@
+//******************************************************************************************
+//  File: WiFiUdp.h
+//
+//  Summary:  Host stand-in for the ESP8266 WiFiUDP class.  Datagrams sent to the board with stubs::udpSend() wait in
+//			  a fixed receive queue of UDP_QUEUE datagrams, like the lwIP buffers - a full queue drops them.  Replies go
+//			  to stubs::udpReply.
+//
+//******************************************************************************************
+
+#ifndef SIM_WIFIUDP_H
+#define SIM_WIFIUDP_H
+
+#include <Arduino.h>
+
+class IPAddress
+{
+	public:
+		IPAddress(uint32_t address = 0) : m_nAddress(address) {}
+		operator uint32_t() const { return m_nAddress; }
+
+	private:
+		uint32_t m_nAddress;
+};
+
+class WiFiUDP
+{
+	public:
+		uint8_t begin(uint16_t port);
+		int parsePacket();                  //size of the next datagram, 0 when none
+		int read(uint8_t *buffer, size_t length);
+		int read(char *buffer, size_t length) { return read((uint8_t *)buffer, length); }
+		int beginPacket(IPAddress ip, uint16_t port);
+		size_t write(const uint8_t *buffer, size_t size);
+		int endPacket();
+		IPAddress remoteIP();
+		uint16_t remotePort();
+};
+
+namespace stubs
+{
+	static const byte UDP_QUEUE = 8;
+	static const byte UDP_MAX_SIZE = 32;
+
+	//a datagram from the LAN - false when the receive queue was full and it was dropped
+	bool udpSend(const uint8_t *data, size_t length, uint16_t fromPort);
+
+	//called with every reply the board sends
+	extern void (*udpReply)(const uint8_t *data, size_t length, uint16_t toPort);
+}
+
+#endif